@@ -0,0 +1,111 @@
+/*
+ *   Copyright (C) 2026 by Jonathan Naylor G4KLX
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program; if not, write to the Free Software
+ *   Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+
+#include "APRSDedupe.h"
+
+#include <cassert>
+#include <cstring>
+
+// Must be a power of two
+const unsigned int DEDUPE_SLOTS = 4096U;
+
+// The number of slots searched for a digest
+const unsigned int DEDUPE_PROBES = 8U;
+
+const unsigned long long FNV_OFFSET = 0xCBF29CE484222325ULL;
+const unsigned long long FNV_PRIME  = 0x00000100000001B3ULL;
+
+CAPRSDedupe::CAPRSDedupe(unsigned int window) :
+m_window(window * 1000ULL),
+m_entries(nullptr)
+{
+	assert(window > 0U);
+
+	m_entries = new CEntry[DEDUPE_SLOTS];
+	::memset(m_entries, 0x00, DEDUPE_SLOTS * sizeof(CEntry));
+}
+
+CAPRSDedupe::~CAPRSDedupe()
+{
+	delete[] m_entries;
+}
+
+unsigned long long CAPRSDedupe::digest(const unsigned char* data, unsigned int length)
+{
+	assert(data != nullptr);
+
+	const unsigned char* colon = (const unsigned char*)::memchr(data, ':', length);
+	if (colon == nullptr)
+		colon = data + length;
+
+	// The header up to the end of the destination
+	unsigned int headerLength = (unsigned int)(colon - data);
+	const unsigned char* comma = (const unsigned char*)::memchr(data, ',', headerLength);
+	if (comma != nullptr)
+		headerLength = (unsigned int)(comma - data);
+
+	unsigned long long hash = FNV_OFFSET;
+
+	for (unsigned int i = 0U; i < headerLength; i++) {
+		hash ^= data[i];
+		hash *= FNV_PRIME;
+	}
+
+	for (const unsigned char* p = colon; p < (data + length); p++) {
+		hash ^= *p;
+		hash *= FNV_PRIME;
+	}
+
+	// Zero marks an empty slot
+	return (hash != 0ULL) ? hash : 1ULL;
+}
+
+bool CAPRSDedupe::isDuplicate(unsigned long long digest, unsigned long long now) const
+{
+	unsigned int slot = (unsigned int)digest & (DEDUPE_SLOTS - 1U);
+
+	for (unsigned int i = 0U; i < DEDUPE_PROBES; i++) {
+		const CEntry& entry = m_entries[(slot + i) & (DEDUPE_SLOTS - 1U)];
+		if (entry.m_digest == digest)
+			return (now - entry.m_time) < m_window;
+	}
+
+	return false;
+}
+
+void CAPRSDedupe::add(unsigned long long digest, unsigned long long now)
+{
+	unsigned int slot = (unsigned int)digest & (DEDUPE_SLOTS - 1U);
+
+	// Use the slot already holding the digest, otherwise replace the oldest
+	CEntry* oldest = nullptr;
+	for (unsigned int i = 0U; i < DEDUPE_PROBES; i++) {
+		CEntry& entry = m_entries[(slot + i) & (DEDUPE_SLOTS - 1U)];
+		if (entry.m_digest == digest) {
+			entry.m_time = now;
+			return;
+		}
+
+		if (oldest == nullptr || entry.m_time < oldest->m_time)
+			oldest = &entry;
+	}
+
+	oldest->m_digest = digest;
+	oldest->m_time   = now;
+}
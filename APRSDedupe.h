@@ -0,0 +1,48 @@
+/*
+ *   Copyright (C) 2026 by Jonathan Naylor G4KLX
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program; if not, write to the Free Software
+ *   Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+
+#if !defined(APRSDedupe_H)
+#define	APRSDedupe_H
+
+// Remembers recently sent frames so that repeats can be ignored. Frames are
+// identified by a 64-bit digest, which is small enough to share with other
+// gateways. The table has a fixed size and does not allocate after creation.
+class CAPRSDedupe {
+public:
+	CAPRSDedupe(unsigned int window);
+	~CAPRSDedupe();
+
+	// Made from the source, destination and information field, the path is ignored
+	static unsigned long long digest(const unsigned char* data, unsigned int length);
+
+	bool isDuplicate(unsigned long long digest, unsigned long long now) const;
+
+	void add(unsigned long long digest, unsigned long long now);
+
+private:
+	struct CEntry {
+		unsigned long long m_digest;
+		unsigned long long m_time;
+	};
+
+	unsigned long long m_window;
+	CEntry*            m_entries;
+};
+
+#endif
@@ -0,0 +1,171 @@
+/*
+ *   Copyright (C) 2026 by Jonathan Naylor G4KLX
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program; if not, write to the Free Software
+ *   Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+
+#include "APRSElection.h"
+#include "Log.h"
+
+#include <cassert>
+#include <cstring>
+
+CAPRSElection::CAPRSElection(CMQTTConnection* mqtt, const std::string& topic, const std::string& instance, unsigned int failoverTime) :
+m_mqtt(mqtt),
+m_topic(topic),
+m_instance(instance),
+m_failoverTime(failoverTime * 1000U),
+m_renewTime(failoverTime * 1000U / 3U),
+m_mutex(),
+m_leader(false),
+m_current(),
+m_age(0U),
+m_renew(0U),
+m_reassert(false),
+m_elections(0U)
+{
+	assert(mqtt != nullptr);
+	assert(!topic.empty());
+	assert(!instance.empty());
+	assert(failoverTime > 0U);
+}
+
+CAPRSElection::~CAPRSElection()
+{
+}
+
+std::string CAPRSElection::getWill() const
+{
+	return m_instance + " dead";
+}
+
+void CAPRSElection::lease(const unsigned char* message, unsigned int length)
+{
+	assert(message != nullptr);
+
+	// The lease is "<instance> alive" from a leader or "<instance> dead" from a Last Will
+	const unsigned char* space = (const unsigned char*)::memchr(message, ' ', length);
+	if (space == nullptr)
+		return;
+
+	std::string instance((const char*)message, space - message);
+	bool alive = (length - (space - message)) == 6U && ::memcmp(space + 1U, "alive", 5U) == 0;
+
+	m_mutex.lock();
+
+	if (!alive) {
+		if (instance == m_current) {
+			LogMessage("The APRS-IS leader %s has gone", instance.c_str());
+			m_current.clear();
+			m_age = m_failoverTime;
+		} else if (m_leader) {
+			// Another gateway has gone and its Last Will has replaced our lease
+			m_reassert = true;
+		}
+	} else if (instance == m_instance) {
+		// Our own lease has come back to us
+		m_age = 0U;
+	} else if (m_leader) {
+		// Two gateways think that they are the leader, the lowest named one wins
+		if (instance < m_instance) {
+			LogMessage("Standing down as the APRS-IS leader in favour of %s", instance.c_str());
+			m_leader  = false;
+			m_current = instance;
+			m_age     = 0U;
+		} else {
+			m_reassert = true;
+		}
+	} else {
+		if (instance != m_current)
+			LogMessage("The APRS-IS leader is %s", instance.c_str());
+
+		m_current = instance;
+		m_age     = 0U;
+	}
+
+	m_mutex.unlock();
+}
+
+void CAPRSElection::clock(unsigned int ms)
+{
+	bool connected = m_mqtt->isConnected();
+	bool publish   = false;
+
+	m_mutex.lock();
+
+	m_age += ms;
+
+	if (m_leader) {
+		m_renew += ms;
+
+		if (m_age >= m_failoverTime) {
+			// Our leases haven't been seen, so another gateway may have taken over
+			LogMessage("Standing down as the APRS-IS leader, the lease has not been renewed");
+			m_leader = false;
+			m_current.clear();
+			m_age = 0U;
+		} else if (m_renew >= m_renewTime || m_reassert) {
+			publish = connected;
+		}
+	} else if (m_age >= m_failoverTime && connected) {
+		LogMessage("Taking over as the APRS-IS leader");
+		m_leader  = true;
+		m_current = m_instance;
+		m_age     = 0U;
+		m_elections++;
+		publish = true;
+	}
+
+	if (publish) {
+		m_renew    = 0U;
+		m_reassert = false;
+	}
+
+	m_mutex.unlock();
+
+	if (publish) {
+		std::string text = m_instance + " alive";
+		m_mqtt->publish(m_topic.c_str(), text);
+	}
+}
+
+void CAPRSElection::resign()
+{
+	m_mutex.lock();
+
+	bool leader = m_leader;
+
+	m_leader = false;
+	m_current.clear();
+
+	m_mutex.unlock();
+
+	// A clean disconnect doesn't send the Last Will, so send the same thing ourselves
+	if (leader && m_mqtt->isConnected()) {
+		LogMessage("Standing down as the APRS-IS leader");
+		m_mqtt->publish(m_topic.c_str(), getWill());
+	}
+}
+
+bool CAPRSElection::isLeader() const
+{
+	return m_leader.load(std::memory_order_relaxed);
+}
+
+unsigned int CAPRSElection::getElections() const
+{
+	return m_elections;
+}
@@ -0,0 +1,68 @@
+/*
+ *   Copyright (C) 2026 by Jonathan Naylor G4KLX
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program; if not, write to the Free Software
+ *   Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+
+#if !defined(APRSElection_H)
+#define	APRSElection_H
+
+#include "MQTTConnection.h"
+#include "Mutex.h"
+
+#include <atomic>
+#include <string>
+
+// Chooses which of a group of gateways holds the APRS-IS connection. The
+// leader keeps a retained lease on an MQTT topic up to date, the others
+// take over when it stops doing so, when it resigns, or when its Last Will
+// arrives. Leases are received on the MQTT thread, the timing is run from
+// the main thread.
+class CAPRSElection {
+public:
+	CAPRSElection(CMQTTConnection* mqtt, const std::string& topic, const std::string& instance, unsigned int failoverTime);
+	~CAPRSElection();
+
+	// The text of the Last Will for this gateway
+	std::string getWill() const;
+
+	void lease(const unsigned char* message, unsigned int length);
+
+	void clock(unsigned int ms);
+
+	// Give up the lease on a clean shutdown, so another gateway takes over at once
+	void resign();
+
+	bool isLeader() const;
+
+	unsigned int getElections() const;
+
+private:
+	CMQTTConnection*  m_mqtt;
+	std::string       m_topic;
+	std::string       m_instance;
+	unsigned int      m_failoverTime;
+	unsigned int      m_renewTime;
+	CMutex            m_mutex;
+	std::atomic<bool> m_leader;
+	std::string       m_current;
+	unsigned int      m_age;
+	unsigned int      m_renew;
+	bool              m_reassert;
+	unsigned int      m_elections;
+};
+
+#endif
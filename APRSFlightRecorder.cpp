@@ -0,0 +1,170 @@
+/*
+ *   Copyright (C) 2026 by Jonathan Naylor G4KLX
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program; if not, write to the Free Software
+ *   Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+#include "APRSFlightRecorder.h"
+#include "APRSValidator.h"
+#include "StopWatch.h"
+#include "Timestamp.h"
+#include "Log.h"
+
+#if !defined(_WIN32) && !defined(_WIN64)
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+#include <cassert>
+#include <cstring>
+#include <cstdio>
+
+static const char* EVENT_TEXT[] = {"arrival", "enqueue", "drop", "send", "downlink"};
+
+static const char* DROP_TEXT[] = {"", "invalid", "duplicate", "over share", "queue full", "discarded"};
+
+CAPRSFlightRecorder::CAPRSFlightRecorder(unsigned int size) :
+m_size(1U),
+m_mask(0U),
+m_events(nullptr),
+m_next(0ULL),
+m_id(0U)
+{
+	assert(size > 0U);
+
+	// A power of two, so the slot is found with a mask
+	while (m_size < size)
+		m_size <<= 1;
+	m_mask = m_size - 1U;
+
+	m_events = new CEvent[m_size];
+
+	for (unsigned int i = 0U; i < m_size; i++)
+		m_events[i].m_sequence.store(0ULL, std::memory_order_relaxed);
+}
+
+CAPRSFlightRecorder::~CAPRSFlightRecorder()
+{
+	delete[] m_events;
+}
+
+unsigned int CAPRSFlightRecorder::nextId()
+{
+	return m_id.fetch_add(1U, std::memory_order_relaxed) + 1U;
+}
+
+void CAPRSFlightRecorder::record(FR_EVENT event, unsigned int id, unsigned int site, unsigned int length, FR_DROP reason, unsigned char detail, const unsigned char* text)
+{
+	unsigned long long index = m_next.fetch_add(1ULL, std::memory_order_relaxed);
+
+	CEvent& e = m_events[index & m_mask];
+
+	// An odd sequence marks the event as being written, the reader skips it
+	e.m_sequence.store(index * 2ULL + 1ULL, std::memory_order_relaxed);
+	std::atomic_thread_fence(std::memory_order_release);
+
+	e.m_time   = CStopWatch::getMicroseconds();
+	e.m_id     = id;
+	e.m_site   = site;
+	e.m_length = (unsigned short)length;
+	e.m_event  = event;
+	e.m_reason = reason;
+	e.m_detail = detail;
+
+	unsigned int n = 0U;
+	if (text != nullptr) {
+		for (; n < (FR_TEXT_LENGTH - 1U) && n < length && text[n] >= 0x20U && text[n] < 0x7FU; n++)
+			e.m_text[n] = char(text[n]);
+	}
+	e.m_text[n] = '\0';
+
+	e.m_sequence.store(index * 2ULL + 2ULL, std::memory_order_release);
+}
+
+bool CAPRSFlightRecorder::dump(const std::string& fileName, const CAPRSSites* sites) const
+{
+#if defined(_WIN32) || defined(_WIN64)
+	FILE* fp = ::fopen(fileName.c_str(), "wt");
+#else
+	// Don't follow a link planted in place of the file, it would be truncated with our rights
+	FILE* fp = nullptr;
+	int fd = ::open(fileName.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_NOFOLLOW, 0600);
+	if (fd >= 0) {
+		fp = ::fdopen(fd, "w");
+		if (fp == nullptr)
+			::close(fd);
+	}
+#endif
+	if (fp == nullptr) {
+		LogError("Cannot open the flight recorder file %s", fileName.c_str());
+		return false;
+	}
+
+	unsigned long long now = CStopWatch::getMicroseconds();
+
+	char timestamp[TIMESTAMP_LENGTH + 1U];
+	CTimestamp::format(CTimestamp::getTime(), ' ', timestamp);
+
+	::fprintf(fp, "# APRSGateway flight recorder, written at %s\n", timestamp);
+	::fprintf(fp, "# ms ago, id, event, site, length, reason, text\n");
+
+	unsigned long long next  = m_next.load(std::memory_order_acquire);
+	unsigned long long first = (next > m_size) ? (next - m_size) : 0ULL;
+
+	unsigned int count = 0U;
+	for (unsigned long long index = first; index < next; index++) {
+		const CEvent& e = m_events[index & m_mask];
+
+		// Skip events that are being written, or have been replaced
+		unsigned long long sequence = e.m_sequence.load(std::memory_order_acquire);
+		if (sequence != (index * 2ULL + 2ULL))
+			continue;
+
+		CEvent copy;
+		copy.m_time   = e.m_time;
+		copy.m_id     = e.m_id;
+		copy.m_site   = e.m_site;
+		copy.m_length = e.m_length;
+		copy.m_event  = e.m_event;
+		copy.m_reason = e.m_reason;
+		copy.m_detail = e.m_detail;
+		::memcpy(copy.m_text, e.m_text, FR_TEXT_LENGTH);
+		copy.m_text[FR_TEXT_LENGTH - 1U] = '\0';
+
+		std::atomic_thread_fence(std::memory_order_acquire);
+		if (e.m_sequence.load(std::memory_order_relaxed) != sequence)
+			continue;
+
+		std::string site = "-";
+		if (sites != nullptr && copy.m_site < sites->getCount())
+			site = sites->getName(copy.m_site);
+
+		std::string reason = DROP_TEXT[(unsigned int)copy.m_reason];
+		if (copy.m_reason == FR_DROP::INVALID)
+			reason += std::string(" ") + CAPRSValidator::getReasonText(APRS_REJECT(copy.m_detail));
+
+		double ago = (now > copy.m_time) ? double(now - copy.m_time) / 1000.0 : 0.0;
+
+		::fprintf(fp, "%.3f, %u, %s, %s, %u, %s, %s\n", ago, copy.m_id, EVENT_TEXT[(unsigned int)copy.m_event], site.c_str(), (unsigned int)copy.m_length, reason.c_str(), copy.m_text);
+
+		count++;
+	}
+
+	::fclose(fp);
+
+	LogMessage("Written %u flight recorder events to %s", count, fileName.c_str());
+
+	return true;
+}
@@ -0,0 +1,87 @@
+/*
+ *   Copyright (C) 2026 by Jonathan Naylor G4KLX
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program; if not, write to the Free Software
+ *   Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+#if !defined(APRSFlightRecorder_H)
+#define	APRSFlightRecorder_H
+
+#include "APRSSites.h"
+
+#include <atomic>
+#include <string>
+
+enum class FR_EVENT : unsigned char {
+	ARRIVAL,
+	ENQUEUE,
+	DROP,
+	SEND,
+	DOWNLINK
+};
+
+enum class FR_DROP : unsigned char {
+	NONE,
+	INVALID,
+	DUPLICATE,
+	OVER_SHARE,
+	QUEUE_FULL,
+	DISCARDED
+};
+
+// Not from any site
+const unsigned int FR_NO_SITE = 0xFFFFFFFFU;
+
+const unsigned int FR_TEXT_LENGTH = 16U;
+
+// Remembers the last events in the life of each frame, so that a missing
+// frame can be followed after the event. Each frame is given an id when it
+// arrives, which is carried through the queue. The events are kept in a
+// fixed ring that any thread can add to without locking, and which is
+// written out as text on request.
+class CAPRSFlightRecorder {
+public:
+	CAPRSFlightRecorder(unsigned int size);
+	~CAPRSFlightRecorder();
+
+	unsigned int nextId();
+
+	// The text is the start of the frame, for arrivals and downlinks, the
+	// detail is the validator reject reason for invalid frames.
+	void record(FR_EVENT event, unsigned int id, unsigned int site, unsigned int length, FR_DROP reason = FR_DROP::NONE, unsigned char detail = 0U, const unsigned char* text = nullptr);
+
+	bool dump(const std::string& fileName, const CAPRSSites* sites) const;
+
+private:
+	struct CEvent {
+		std::atomic<unsigned long long> m_sequence;
+		unsigned long long              m_time;
+		unsigned int                    m_id;
+		unsigned int                    m_site;
+		unsigned short                  m_length;
+		FR_EVENT                        m_event;
+		FR_DROP                         m_reason;
+		unsigned char                   m_detail;
+		char                            m_text[FR_TEXT_LENGTH];
+	};
+
+	unsigned int                    m_size;
+	unsigned int                    m_mask;
+	CEvent*                         m_events;
+	std::atomic<unsigned long long> m_next;
+	std::atomic<unsigned int>       m_id;
+};
+
+#endif
@@ -18,6 +18,10 @@
 
 #include "APRSGateway.h"
 #include "MQTTConnection.h"
+#include "Allocations.h"
+#include "Latency.h"
+#include "Metrics.h"
+#include "Profile.h"
 #include "StopWatch.h"
 #include "TCPSocket.h"
 #include "Version.h"
@@ -47,6 +51,7 @@ const char* DEFAULT_INI_FILE = "APRSGateway.ini";
 const char* DEFAULT_INI_FILE = "/etc/APRSGateway.ini";
 #endif
 
+#include <csignal>
 #include <cstdio>
 #include <cstdlib>
 #include <cstdarg>
@@ -58,15 +63,29 @@ extern CMQTTConnection* m_mqtt;
 
 static CAPRSGateway* gateway = nullptr;
 
+const unsigned int MAX_INSTANCE_LENGTH = 40U;
+
+#if defined(PROFILING)
+// Seconds between the reports of where the time is going
+const unsigned int PROFILE_REPORT_TIME = 60U;
+#endif
+
 static bool m_killed = false;
 static int  m_signal = 0;
 
+static volatile sig_atomic_t m_dump = 0;
+
 #if !defined(_WIN32) && !defined(_WIN64)
 static void sigHandler(int signum)
 {
 	m_killed = true;
 	m_signal = signum;
 }
+
+static void sigDumpHandler(int)
+{
+	m_dump = 1;
+}
 #endif
 
 
@@ -92,6 +111,7 @@ int main(int argc, char** argv)
 	::signal(SIGINT,  sigHandler);
 	::signal(SIGTERM, sigHandler);
 	::signal(SIGHUP,  sigHandler);
+	::signal(SIGUSR1, sigDumpHandler);
 #endif
 
 	int ret = 0;
@@ -130,12 +150,34 @@ int main(int argc, char** argv)
 
 CAPRSGateway::CAPRSGateway(const std::string& file) :
 m_conf(file),
-m_writer(nullptr)
+m_writer(nullptr),
+m_validator(nullptr),
+m_sites(nullptr),
+m_allocating(0U),
+m_dedupe(nullptr),
+m_instance(),
+m_clusterTopic(),
+m_election(nullptr),
+m_leader(false),
+m_server(nullptr),
+m_ingest(nullptr),
+m_kiss(nullptr),
+m_metrics(nullptr),
+m_trace(nullptr),
+m_recorder(nullptr),
+m_dumpRequested(false),
+m_downlink(false),
+m_uplinkMutex(),
+m_duplicates(0U),
+m_digestsSent(0U),
+m_digestsReceived(0U)
 {
 }
 
 CAPRSGateway::~CAPRSGateway()
 {
+	delete m_trace;
+	delete m_recorder;
 }
 
 int CAPRSGateway::run()
@@ -210,24 +252,195 @@ int CAPRSGateway::run()
 		::close(STDERR_FILENO);
 	}
 #endif
-	m_writer = new CAPRSWriterThread(m_conf.getCallsign(), m_conf.getAPRSPassword(), m_conf.getAPRSServer(), m_conf.getAPRSPort(), VERSION, m_conf.getDebug());
+	if (m_conf.getMQTTReconnectDelay() == 0U || m_conf.getMQTTReconnectMaxDelay() < m_conf.getMQTTReconnectDelay()) {
+		LogError("MQTT ReconnectDelay must be at least 1 and no more than ReconnectMaxDelay");
+		return 1;
+	}
+
+	if (!m_conf.getMQTTBatchTopics().empty() && m_conf.getMQTTBatchSize() == 0U) {
+		LogError("MQTT BatchSize must be at least 1 when batching is used");
+		return 1;
+	}
+
+	if (m_conf.getClusterEnabled() && m_conf.getClusterDedupeWindow() == 0U) {
+		LogError("Cluster DedupeWindow must be at least 1");
+		return 1;
+	}
+
+	if (m_conf.getClusterElection() && m_conf.getClusterFailoverTime() == 0U) {
+		LogError("Cluster FailoverTime must be at least 1");
+		return 1;
+	}
+
+	if (m_conf.getServerEnabled() && (m_conf.getServerMaxClients() == 0U || m_conf.getServerBufferSize() == 0U)) {
+		LogError("Server MaxClients and BufferSize must be at least 1");
+		return 1;
+	}
+
+	m_writer = new CAPRSWriterThread(m_conf.getCallsign(), m_conf.getAPRSPassword(), m_conf.getAPRSServer(), m_conf.getAPRSPort(), m_conf.getAPRSFilter(), VERSION, m_conf.getDebug());
+
+	m_trace = new CAPRSTrace(m_conf.getDebug(), m_conf.getLogTraceSample(), m_conf.getLogTraceRate(), m_conf.getLogTraceCallsigns());
+	m_writer->setTrace(m_trace);
+
+	if (m_conf.getLogFlightRecorder() > 0U) {
+		m_recorder = new CAPRSFlightRecorder(m_conf.getLogFlightRecorder());
+		m_writer->setRecorder(m_recorder);
+	}
+
+	// Only the leader connects to APRS-IS
+	bool election = m_conf.getClusterElection();
+	if (election)
+		m_writer->setEnabled(false, m_conf.getClusterFailoverTime() * 2U);
+
+	if (m_conf.getAPRSUDPPort() > 0U)
+		m_writer->setUDP(m_conf.getAPRSUDPPort(), m_conf.getAPRSUDPRate());
+
+	m_writer->setPacing(m_conf.getAPRSMaxFrameRate(), m_conf.getAPRSMaxByteRate(), m_conf.getAPRSPacingBurst());
+	m_writer->setLinger(m_conf.getAPRSLinger());
+	m_writer->setSlowFrames(m_conf.getLogSlowFrameTime());
+	m_writer->setMaxSendQueue(m_conf.getAPRSMaxSendQueue());
+
 	ret = m_writer->start();
 	if (!ret) {
 		delete m_writer;
 		return 1;
 	}
 
-	std::vector<std::pair<std::string, void (*)(const unsigned char*, unsigned int)>> subscriptions;
-	subscriptions.push_back(std::make_pair("aprs", CAPRSGateway::onAPRS));
+	m_validator = new CAPRSValidator(m_conf.getCallsign(), FRAME_BUFFER_SIZE);
+
+	m_sites = new CAPRSSites(m_writer->getQueueSize());
+	m_writer->setSites(m_sites);
+
+	std::vector<std::pair<std::string, void (*)(const char*, const unsigned char*, unsigned int)>> subscriptions;
+	subscriptions.push_back(std::make_pair(m_conf.getMQTTAPRSTopic(), CAPRSGateway::onAPRS));
+
+	std::string commandTopic = m_conf.getMQTTCommandTopic();
+	if (!commandTopic.empty())
+		subscriptions.push_back(std::make_pair(commandTopic, CAPRSGateway::onCommand));
+
+	bool cluster = m_conf.getClusterEnabled();
+	if (cluster && election) {
+		LogError("Cluster sharing and election cannot be used together");
+		m_writer->stop();
+		delete m_writer;
+		delete m_validator;
+		delete m_sites;
+		return 1;
+	}
+
+	if (cluster || election) {
+		m_instance = m_conf.getClusterInstance();
+		if (m_instance.empty()) {
+			char instance[50U];
+#if defined(_WIN32) || defined(_WIN64)
+			::sprintf(instance, "%s.%u.%04X", m_conf.getCallsign().c_str(), (unsigned int)::GetCurrentProcessId(), (unsigned int)(CStopWatch::getMicroseconds() & 0xFFFFU));
+#else
+			::sprintf(instance, "%s.%u.%04X", m_conf.getCallsign().c_str(), (unsigned int)::getpid(), (unsigned int)(CStopWatch::getMicroseconds() & 0xFFFFU));
+#endif
+			m_instance = instance;
+		}
+
+		// Keep the digest messages short
+		if (m_instance.size() > MAX_INSTANCE_LENGTH)
+			m_instance.resize(MAX_INSTANCE_LENGTH);
+	}
+
+	if (cluster) {
+		m_dedupe = new CAPRSDedupe(m_conf.getClusterDedupeWindow());
+
+		m_clusterTopic = m_conf.getClusterTopic();
+		subscriptions.push_back(std::make_pair(m_clusterTopic, CAPRSGateway::onCluster));
+
+		LogInfo("Cluster instance %s in group %s", m_instance.c_str(), m_conf.getClusterGroup().c_str());
+	}
+
+	if (election) {
+		subscriptions.push_back(std::make_pair(m_conf.getClusterLeaseTopic(), CAPRSGateway::onLease));
+
+		LogInfo("Cluster instance %s electing the APRS-IS leader", m_instance.c_str());
+	}
 
 	m_mqtt = new CMQTTConnection(m_conf.getMQTTAddress(), m_conf.getMQTTPort(), m_conf.getMQTTName(), m_conf.getMQTTAuthEnabled(), m_conf.getMQTTUsername(), m_conf.getMQTTPassword(), subscriptions, m_conf.getMQTTKeepalive());
+	m_mqtt->setQoS(m_conf.getMQTTAPRSTopic(), MQTT_QOS(m_conf.getMQTTAPRSQoS()));
+	m_mqtt->setQoS("log", MQTT_QOS(m_conf.getMQTTLogQoS()));
+	m_mqtt->setQoS("json", MQTT_QOS(m_conf.getMQTTJSONQoS()));
+	m_mqtt->setInFlight(m_conf.getMQTTInFlight(), m_conf.getMQTTQueueLimit());
+	m_mqtt->setReconnect(m_conf.getMQTTReconnectDelay(), m_conf.getMQTTReconnectMaxDelay(), m_conf.getMQTTBufferSize());
+
+	// The broker shares the frames out between the gateways in the group
+	if (cluster)
+		m_mqtt->setShared(m_conf.getMQTTAPRSTopic(), m_conf.getClusterGroup());
+
+	// The lease stays on the broker, and is replaced by our Last Will if we vanish
+	if (election) {
+		m_election = new CAPRSElection(m_mqtt, m_conf.getClusterLeaseTopic(), m_instance, m_conf.getClusterFailoverTime());
+
+		m_mqtt->setQoS(m_conf.getClusterLeaseTopic(), MQTT_QOS::AT_LEAST_ONCE);
+		m_mqtt->setRetain(m_conf.getClusterLeaseTopic(), true);
+		m_mqtt->setWill(m_conf.getClusterLeaseTopic(), m_election->getWill(), true);
+	}
+
+	std::vector<std::string> batchTopics = m_conf.getMQTTBatchTopics();
+	for (std::vector<std::string>::const_iterator it = batchTopics.cbegin(); it != batchTopics.cend(); ++it)
+		m_mqtt->setBatching(*it, m_conf.getMQTTBatchFormat() == 1U ? MQTT_BATCH::JSON_ARRAY : MQTT_BATCH::LINES, m_conf.getMQTTBatchSize(), m_conf.getMQTTBatchLinger());
 	ret = m_mqtt->open();
 	if (!ret) {
 		m_writer->stop();
 		delete m_writer;
+		delete m_validator;
+		delete m_sites;
+		delete m_dedupe;
+		delete m_election;
 		return 1;
 	}
 
+	if (m_conf.getServerEnabled()) {
+		m_server = new CAPRSServerThread(m_conf.getCallsign(), m_conf.getServerAddress(), m_conf.getServerPort(), m_conf.getServerMaxClients(), m_conf.getServerBufferSize(), VERSION);
+		m_server->setUplinkCallback(CAPRSGateway::onServerUplink);
+
+		ret = m_server->start();
+		if (!ret) {
+			delete m_server;
+			m_server = nullptr;
+		}
+	}
+
+	if (!m_conf.getIngestUnixPath().empty() || m_conf.getIngestUDPPort() > 0U) {
+		m_ingest = new CAPRSIngestThread(m_conf.getIngestUnixPath(), m_conf.getIngestUDPAddress(), m_conf.getIngestUDPPort());
+		m_ingest->setCallback(CAPRSGateway::onIngest);
+
+		ret = m_ingest->start();
+		if (!ret) {
+			delete m_ingest;
+			m_ingest = nullptr;
+		}
+	}
+
+	if (m_conf.getKISSEnabled()) {
+		m_kiss = new CAPRSKISSThread(m_conf.getKISSAddress(), m_conf.getKISSPort());
+		m_kiss->setCallback(CAPRSGateway::onKISS);
+
+		ret = m_kiss->start();
+		if (!ret) {
+			delete m_kiss;
+			m_kiss = nullptr;
+		}
+	}
+
+	if (m_conf.getMetricsEnabled()) {
+		m_metrics = new CMetricsServerThread(m_conf.getMetricsAddress(), m_conf.getMetricsPort());
+
+		ret = m_metrics->start();
+		if (!ret) {
+			delete m_metrics;
+			m_metrics = nullptr;
+		}
+	}
+
+	m_downlink = m_conf.getMQTTDownlink();
+	if (m_downlink || m_server != nullptr)
+		m_writer->setReadAPRSCallback(CAPRSGateway::onDownlink);
+
 	CStopWatch stopWatch;
 	stopWatch.start();
 
@@ -236,21 +449,168 @@ int CAPRSGateway::run()
 
 	writeJSONStatus("APRSGateway is starting");
 
+	CTimer statsTimer(1000U, m_conf.getMQTTStatsInterval());
+	statsTimer.start();
+
+#if defined(PROFILING)
+	PROFILE_THREAD("main");
+
+	CTimer profileTimer(1000U, PROFILE_REPORT_TIME);
+	profileTimer.start();
+#endif
+
 	while (!m_killed) {
 		unsigned int ms = stopWatch.elapsed();
 		stopWatch.start();
 
 		m_writer->clock(ms);
+		m_mqtt->clock(ms);
+
+		CMetrics::set(GAUGE::QUEUE_DEPTH, m_writer->getQueueUsed());
+		CMetrics::set(GAUGE::APRS_CONNECTED, m_writer->isConnected() ? 1LL : 0LL);
+		CMetrics::set(GAUGE::APRS_ENABLED, (m_election == nullptr || m_leader) ? 1LL : 0LL);
+		CMetrics::set(GAUGE::MQTT_CONNECTED, m_mqtt->isConnected() ? 1LL : 0LL);
+
+		statsTimer.clock(ms);
+		if (statsTimer.isRunning() && statsTimer.hasExpired()) {
+			writeJSONStats();
+			statsTimer.start();
+		}
+
+#if defined(PROFILING)
+		profileTimer.clock(ms);
+		if (profileTimer.hasExpired()) {
+			CProfile::report();
+			profileTimer.start();
+		}
+#endif
+
+		if (m_election != nullptr) {
+			m_election->clock(ms);
+
+			bool leader = m_election->isLeader();
+			if (leader != m_leader) {
+				m_writer->setEnabled(leader, m_conf.getClusterFailoverTime() * 2U);
+				m_leader = leader;
+			}
+		}
+
+		// Asked for by SIGUSR1 or an MQTT command
+		if (m_dump != 0 || m_dumpRequested) {
+			m_dump = 0;
+			m_dumpRequested = false;
+
+			if (m_recorder != nullptr)
+				m_recorder->dump(m_conf.getLogFlightRecorderFile(), m_sites);
+			else
+				LogWarning("The flight recorder is not enabled");
+		}
 
 		if (ms < 20U)
 			CThread::sleep(20U);
 	}
 
+#if defined(PROFILING)
+	CProfile::report();
+#endif
+
 	LogInfo("APRSGateway is stopping");
 	writeJSONStatus("APRSGateway is stoppng");
 
+	if (m_metrics != nullptr) {
+		m_metrics->stop();
+		LogMessage("Metrics server requests: %u", m_metrics->getRequests());
+		delete m_metrics;
+		m_metrics = nullptr;
+	}
+
+	if (m_kiss != nullptr) {
+		m_kiss->stop();
+		LogMessage("KISS frames gated: %u, invalid: %u", m_kiss->getFrames(), m_kiss->getInvalid());
+		delete m_kiss;
+		m_kiss = nullptr;
+	}
+
+	if (m_ingest != nullptr) {
+		m_ingest->stop();
+		LogMessage("APRS frames ingested: %u, in %u batches, too long: %u", m_ingest->getReceived(), m_ingest->getBatches(), m_ingest->getTruncated());
+		delete m_ingest;
+		m_ingest = nullptr;
+	}
+
+	if (m_server != nullptr) {
+		m_server->stop();
+		LogMessage("APRS server connections: %u, evicted: %u, frames uplinked: %u, lines dropped: %u", m_server->getConnects(), m_server->getEvictions(), m_server->getUplinked(), m_server->getDropped());
+		delete m_server;
+		m_server = nullptr;
+	}
+
 	m_writer->stop();
+
+	// Nothing more will go to APRS-IS, so let another gateway take over now
+	if (m_election != nullptr)
+		m_election->resign();
+
+	if (m_conf.getAPRSUDPPort() > 0U)
+		LogMessage("APRS frames sent by UDP: %u, fallbacks to TCP: %u", m_writer->getUDPFrames(), m_writer->getUDPFallbacks());
+
+	unsigned int frames = m_writer->getTCPFrames();
+	unsigned int writes = m_writer->getTCPWrites();
+	if (writes > 0U)
+		LogMessage("APRS frames sent by TCP: %u, in %u writes, %.2f writes per frame", frames, writes, float(writes) / float(frames));
+
+	unsigned int lingered = m_writer->getLingeredFrames();
+	if (lingered > 0U)
+		LogMessage("APRS frames held back by linger: %u, mean delay: %llu us, max delay: %llu us", lingered, m_writer->getLingerDelay() / lingered, m_writer->getMaxLingerDelay());
+
+	unsigned int paced = m_writer->getPacedFrames();
+	if (paced > 0U)
+		LogMessage("APRS frames held back by pacing: %u, mean delay: %llu us, max delay: %llu us", paced, m_writer->getPacingDelay() / paced, m_writer->getMaxPacingDelay());
+	else
+		LogMessage("APRS frames held back by pacing: 0");
+
+	logLatencyStats();
+
+	LogMessage("APRS TCP retransmits: %llu, pauses for the socket send queue: %u", CMetrics::get(METRIC::TCP_RETRANSMITS), m_writer->getSendQueueStalls());
+
+	if (m_writer->getSlowFrames() > 0U)
+		LogMessage("APRS frames slower than %u ms: %u", m_conf.getLogSlowFrameTime(), m_writer->getSlowFrames());
+
+	if (m_trace->getTraced() > 0U || m_trace->getSuppressed() > 0U)
+		LogMessage("APRS frames traced: %u, suppressed by the trace rate: %u", m_trace->getTraced(), m_trace->getSuppressed());
+
+	if (CAllocations::isEnabled())
+		LogMessage("APRS frames that allocated memory, queueing: %u, sending: %u", m_allocating, m_writer->getAllocatingFrames());
+
+	logValidatorStats();
+	logSiteStats();
+	logMQTTStats();
+
+	if (m_election != nullptr)
+		LogMessage("Cluster elections won: %u", m_election->getElections());
+
+	if (m_dedupe != nullptr)
+		LogMessage("Cluster duplicates ignored: %u, digests sent: %u, digests received: %u", m_duplicates, m_digestsSent, m_digestsReceived);
+
+	// Stop the logger, which passes on its last records, and then close MQTT,
+	// sending any partial batches. Both are started again on a restart. Once
+	// closed no more frames can arrive, so the rest can go.
+	::LogFinalise();
+
 	delete m_writer;
+	m_writer = nullptr;
+
+	delete m_validator;
+	m_validator = nullptr;
+
+	delete m_sites;
+	m_sites = nullptr;
+
+	delete m_dedupe;
+	m_dedupe = nullptr;
+
+	delete m_election;
+	m_election = nullptr;
 
 	return 0;
 }
@@ -265,17 +625,366 @@ void CAPRSGateway::writeJSONStatus(const std::string& status)
 	WriteJSON("status", json);
 }
 
-void CAPRSGateway::writeAPRS(const std::string& message)
+void CAPRSGateway::writeJSONStats()
+{
+	nlohmann::json json;
+
+	json["timestamp"] = CUtils::createTimestamp();
+
+	nlohmann::json counters;
+	for (unsigned int i = 0U; i < METRIC_COUNT; i++)
+		counters[CMetrics::getName(METRIC(i))] = CMetrics::get(METRIC(i));
+	json["counters"] = counters;
+
+	nlohmann::json gauges;
+	for (unsigned int i = 0U; i < GAUGE_COUNT; i++)
+		gauges[CMetrics::getName(GAUGE(i))] = CMetrics::get(GAUGE(i));
+	json["gauges"] = gauges;
+
+	nlohmann::json histograms;
+	for (unsigned int i = 0U; i < HISTOGRAM_COUNT; i++) {
+		unsigned long long buckets[HISTOGRAM_BUCKETS];
+		unsigned long long count, sum;
+		CMetrics::get(HISTOGRAM(i), buckets, count, sum);
+
+		// The bounds are in microseconds, the last bucket has no bound
+		nlohmann::json bounds  = nlohmann::json::array();
+		nlohmann::json entries = nlohmann::json::array();
+		for (unsigned int j = 0U; j < HISTOGRAM_BUCKETS; j++) {
+			if (j < (HISTOGRAM_BUCKETS - 1U))
+				bounds.push_back(CMetrics::getBound(j));
+			entries.push_back(buckets[j]);
+		}
+
+		nlohmann::json histogram;
+		histogram["bounds"]  = bounds;
+		histogram["buckets"] = entries;
+		histogram["count"]   = count;
+		histogram["sum"]     = sum;
+
+		histograms[CMetrics::getName(HISTOGRAM(i))] = histogram;
+	}
+	json["histograms"] = histograms;
+
+	// Percentiles of the time taken by each stage, in microseconds
+	nlohmann::json latency;
+	for (unsigned int i = 0U; i < LATENCY_COUNT; i++) {
+		nlohmann::json stage;
+		stage["count"] = CLatency::getCount(LATENCY(i));
+		stage["p50"]   = CLatency::getPercentile(LATENCY(i), 50.0);
+		stage["p99"]   = CLatency::getPercentile(LATENCY(i), 99.0);
+		stage["p999"]  = CLatency::getPercentile(LATENCY(i), 99.9);
+		stage["max"]   = CLatency::getMax(LATENCY(i));
+
+		latency[CLatency::getName(LATENCY(i))] = stage;
+	}
+	json["latency"] = latency;
+
+	WriteJSON("stats", json);
+}
+
+void CAPRSGateway::writeAPRS(const char* topic, const unsigned char* message, unsigned int length, APRS_ORIGIN origin, unsigned long long received)
 {
 	assert(m_writer != nullptr);
+	assert(m_validator != nullptr);
+	assert(m_sites != nullptr);
+
+	// Taken before any wait for the lock, which counts against the frame
+	if (received == 0ULL)
+		received = CStopWatch::getMicroseconds();
+
+	// Frames arrive from the MQTT, APRS server, ingest and KISS threads
+	m_uplinkMutex.lock();
+	uplink(topic, message, length, origin, received);
+	m_uplinkMutex.unlock();
+}
+
+void CAPRSGateway::uplink(const char* topic, const unsigned char* message, unsigned int length, APRS_ORIGIN origin, unsigned long long received)
+{
+	unsigned int site = m_sites->find(topic);
+	m_sites->received(site);
+
+	CMetrics::increment(METRIC::FRAMES_IN);
+
+	unsigned int id = 0U;
+	if (m_recorder != nullptr) {
+		id = m_recorder->nextId();
+		m_recorder->record(FR_EVENT::ARRIVAL, id, site, length, FR_DROP::NONE, 0U, message);
+	}
+
+	unsigned long long allocations = CAllocations::getThreadCount();
+
+	bool addQ;
+	APRS_REJECT reason = m_validator->validate(message, length, addQ, origin);
+	if (reason != APRS_REJECT::NONE) {
+		LogDebug("Rejected APRS frame from %s, %s", m_sites->getName(site).c_str(), CAPRSValidator::getReasonText(reason));
+		m_sites->rejected(site);
+
+		if (m_recorder != nullptr)
+			m_recorder->record(FR_EVENT::DROP, id, site, length, FR_DROP::INVALID, (unsigned char)reason);
+
+		CMetrics::increment(METRIC::DROPPED_INVALID);
+		return;
+	}
+
+	// Another gateway in the cluster, or this one, has already sent the frame
+	unsigned long long digest = 0ULL;
+	unsigned long long now    = 0ULL;
+	if (m_dedupe != nullptr) {
+		digest = CAPRSDedupe::digest(message, length);
+		now    = CStopWatch::getMicroseconds() / 1000ULL;
+
+		if (m_dedupe->isDuplicate(digest, now)) {
+			LogDebug("Ignored duplicate APRS frame from %s", m_sites->getName(site).c_str());
+			m_duplicates++;
+
+			if (m_recorder != nullptr)
+				m_recorder->record(FR_EVENT::DROP, id, site, length, FR_DROP::DUPLICATE);
+
+			CMetrics::increment(METRIC::DROPPED_DUPLICATE);
+			return;
+		}
+	}
+
+	// The frame is assembled in the queue straight from the MQTT payload
+	APRSFramePart parts[4U];
+	unsigned int count = 0U;
+
+	if (addQ) {
+		unsigned int headerLength = (unsigned int)((const unsigned char*)::memchr(message, ':', length) - message);
+
+		const std::string& qConstruct = m_validator->getQConstruct(origin);
+
+		parts[count].m_data     = message;
+		parts[count++].m_length = headerLength;
+		parts[count].m_data     = (const unsigned char*)qConstruct.c_str();
+		parts[count++].m_length = (unsigned int)qConstruct.size();
+		parts[count].m_data     = message + headerLength;
+		parts[count++].m_length = length - headerLength;
+	} else {
+		parts[count].m_data     = message;
+		parts[count++].m_length = length;
+	}
+
+	parts[count].m_data     = (const unsigned char*)"\r\n";
+	parts[count++].m_length = 2U;
 
-	m_writer->write(message);
+	unsigned int frameLength = 0U;
+	for (unsigned int i = 0U; i < count; i++)
+		frameLength += parts[i].m_length;
+
+	// Stop one busy site from filling the queue at the expense of the others
+	if (!m_sites->hasShare(site, frameLength)) {
+		LogDebug("Dropped APRS frame from %s, over its share of the queue", m_sites->getName(site).c_str());
+		m_sites->dropped(site);
+
+		if (m_recorder != nullptr)
+			m_recorder->record(FR_EVENT::DROP, id, site, frameLength, FR_DROP::OVER_SHARE);
+
+		CMetrics::increment(METRIC::DROPPED_OVER_SHARE);
+		return;
+	}
+
+	bool ret = m_writer->write(parts, count, site, id, received);
+	if (!ret) {
+		m_sites->dropped(site);
+
+		if (m_recorder != nullptr)
+			m_recorder->record(FR_EVENT::DROP, id, site, frameLength, FR_DROP::QUEUE_FULL);
+
+		CMetrics::increment(METRIC::DROPPED_QUEUE_FULL);
+		return;
+	}
+
+	if (m_recorder != nullptr)
+		m_recorder->record(FR_EVENT::ENQUEUE, id, site, frameLength);
+
+	if (CAllocations::getThreadCount() != allocations)
+		m_allocating++;
+
+	if (m_dedupe != nullptr) {
+		m_dedupe->add(digest, now);
+
+		char text[MAX_INSTANCE_LENGTH + 20U];
+		::sprintf(text, "%s %016llX", m_instance.c_str(), digest);
+		m_mqtt->publish(m_clusterTopic.c_str(), text);
+
+		m_digestsSent++;
+	}
 }
 
-void CAPRSGateway::onAPRS(const unsigned char* message, unsigned int length)
+void CAPRSGateway::readDigests(const unsigned char* message, unsigned int length)
+{
+	assert(message != nullptr);
+	assert(m_dedupe != nullptr);
+
+	unsigned long long now = CStopWatch::getMicroseconds() / 1000ULL;
+
+	// The frames being uplinked from the other threads use the same table
+	m_uplinkMutex.lock();
+
+	// Each line holds the instance that sent the frame and its digest, batching may put several together
+	const unsigned char* end = message + length;
+	const unsigned char* p   = message;
+	while (p < end) {
+		const unsigned char* eol = (const unsigned char*)::memchr(p, '\n', end - p);
+		if (eol == nullptr)
+			eol = end;
+
+		const unsigned char* space = (const unsigned char*)::memchr(p, ' ', eol - p);
+		if (space != nullptr && (eol - space) == 17) {
+			// Our own digests are already in the table
+			unsigned int instanceLength = (unsigned int)(space - p);
+			if (instanceLength != m_instance.size() || ::memcmp(p, m_instance.c_str(), instanceLength) != 0) {
+				char text[20U];
+				::memcpy(text, space + 1U, 16U);
+				text[16U] = '\0';
+
+				unsigned long long digest = ::strtoull(text, nullptr, 16);
+				if (digest != 0ULL) {
+					m_dedupe->add(digest, now);
+					m_digestsReceived++;
+				}
+			}
+		}
+
+		p = eol + 1U;
+	}
+
+	m_uplinkMutex.unlock();
+}
+
+void CAPRSGateway::logValidatorStats() const
+{
+	assert(m_validator != nullptr);
+
+	LogMessage("APRS frames accepted: %u", m_validator->getAccepted());
+
+	for (unsigned int i = (unsigned int)APRS_REJECT::EMPTY; i < APRS_REJECT_COUNT; i++) {
+		unsigned int count = m_validator->getRejected(APRS_REJECT(i));
+		if (count > 0U)
+			LogMessage("APRS frames rejected, %s: %u", CAPRSValidator::getReasonText(APRS_REJECT(i)), count);
+	}
+}
+
+void CAPRSGateway::logMQTTStats() const
+{
+	assert(m_mqtt != nullptr);
+
+	LogMessage("MQTT publishes acknowledged: %u, mean latency: %llu us, max latency: %llu us", m_mqtt->getAckCount(), m_mqtt->getAckLatencyMean(), m_mqtt->getAckLatencyMax());
+	LogMessage("MQTT in flight: %u, peak in flight: %u, dropped: %u", m_mqtt->getInFlight(), m_mqtt->getInFlightPeak(), m_mqtt->getDropped());
+	LogMessage("MQTT reconnects: %u, disconnected for: %llu ms, buffered: %u, dropped from the buffer: %u", m_mqtt->getReconnects(), m_mqtt->getDisconnectedTime(), m_mqtt->getBuffered(), m_mqtt->getBufferDropped());
+}
+
+void CAPRSGateway::logLatencyStats() const
+{
+	for (unsigned int i = 0U; i < LATENCY_COUNT; i++) {
+		LATENCY stage = LATENCY(i);
+		if (CLatency::getCount(stage) == 0ULL)
+			continue;
+
+		LogMessage("APRS frame %s time, p50: %llu us, p99: %llu us, p99.9: %llu us, max: %llu us", CLatency::getName(stage),
+			CLatency::getPercentile(stage, 50.0), CLatency::getPercentile(stage, 99.0), CLatency::getPercentile(stage, 99.9), CLatency::getMax(stage));
+	}
+}
+
+void CAPRSGateway::logSiteStats() const
+{
+	assert(m_sites != nullptr);
+
+	for (unsigned int i = 0U; i < m_sites->getCount(); i++)
+		LogMessage("Site %s, received: %u, rejected: %u, dropped: %u, sent: %u", m_sites->getName(i).c_str(), m_sites->getReceived(i), m_sites->getRejected(i), m_sites->getDropped(i), m_sites->getSent(i));
+}
+
+void CAPRSGateway::onAPRS(const char* topic, const unsigned char* message, unsigned int length)
+{
+	assert(gateway != nullptr);
+	assert(topic != nullptr);
+	assert(message != nullptr);
+
+	PROFILE_ZONE(ZONE::ON_APRS);
+
+	gateway->writeAPRS(topic, message, length, APRS_ORIGIN::GATEWAY, CMQTTConnection::getMessageTime());
+}
+
+void CAPRSGateway::onCluster(const char* topic, const unsigned char* message, unsigned int length)
+{
+	assert(gateway != nullptr);
+	assert(topic != nullptr);
+	assert(message != nullptr);
+
+	gateway->readDigests(message, length);
+}
+
+void CAPRSGateway::onLease(const char* topic, const unsigned char* message, unsigned int length)
+{
+	assert(gateway != nullptr);
+	assert(topic != nullptr);
+	assert(message != nullptr);
+
+	if (gateway->m_election != nullptr)
+		gateway->m_election->lease(message, length);
+}
+
+void CAPRSGateway::onCommand(const char* topic, const unsigned char* message, unsigned int length)
 {
 	assert(gateway != nullptr);
+	assert(topic != nullptr);
 	assert(message != nullptr);
 
-	gateway->writeAPRS(std::string((char*)message, length));
+	if (gateway->m_trace != nullptr && gateway->m_trace->command(message, length))
+		return;
+
+	if (length == 4U && ::memcmp(message, "dump", 4U) == 0) {
+		gateway->m_dumpRequested = true;
+		return;
+	}
+
+	LogWarning("Unknown command received: %.*s", int(length), message);
+}
+
+void CAPRSGateway::onIngest(const char* source, const unsigned char* message, unsigned int length)
+{
+	assert(gateway != nullptr);
+	assert(source != nullptr);
+	assert(message != nullptr);
+
+	gateway->writeAPRS(source, message, length);
+}
+
+void CAPRSGateway::onKISS(const unsigned char* message, unsigned int length)
+{
+	assert(gateway != nullptr);
+	assert(message != nullptr);
+
+	gateway->writeAPRS("kiss", message, length, APRS_ORIGIN::RF);
+}
+
+void CAPRSGateway::onServerUplink(const unsigned char* message, unsigned int length)
+{
+	assert(gateway != nullptr);
+	assert(message != nullptr);
+
+	gateway->writeAPRS("server", message, length, APRS_ORIGIN::CLIENT);
+}
+
+void CAPRSGateway::onDownlink(const std::string& line)
+{
+	assert(gateway != nullptr);
+
+	if (gateway->m_recorder != nullptr)
+		gateway->m_recorder->record(FR_EVENT::DOWNLINK, gateway->m_recorder->nextId(), FR_NO_SITE, (unsigned int)line.size(), FR_DROP::NONE, 0U, (const unsigned char*)line.c_str());
+
+	if (gateway->m_server != nullptr)
+		gateway->m_server->downlink(line);
+
+	if (!gateway->m_downlink || m_mqtt == nullptr)
+		return;
+
+	unsigned int length = (unsigned int)line.size();
+	while (length > 0U && (line[length - 1U] == '\r' || line[length - 1U] == '\n'))
+		length--;
+
+	if (length > 0U)
+		m_mqtt->publish("downlink", (const unsigned char*)line.c_str(), length);
 }
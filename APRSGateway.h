@@ -19,10 +19,22 @@
 #if !defined(APRSGateway_H)
 #define	APRSGateway_H
 
+#include "APRSServerThread.h"
+#include "APRSIngestThread.h"
+#include "APRSKISSThread.h"
 #include "APRSWriterThread.h"
+#include "APRSValidator.h"
+#include "APRSFlightRecorder.h"
+#include "APRSElection.h"
+#include "APRSTrace.h"
+#include "APRSDedupe.h"
+#include "APRSSites.h"
+#include "MetricsServerThread.h"
 #include "Timer.h"
+#include "Mutex.h"
 #include "Conf.h"
 
+#include <atomic>
 #include <cstdio>
 #include <string>
 #include <vector>
@@ -50,12 +62,48 @@ public:
 private:
 	CConf              m_conf;
 	CAPRSWriterThread* m_writer;
+	CAPRSValidator*    m_validator;
+	CAPRSSites*        m_sites;
+	unsigned int       m_allocating;
+	CAPRSDedupe*       m_dedupe;
+	std::string        m_instance;
+	std::string        m_clusterTopic;
+	CAPRSElection*     m_election;
+	bool               m_leader;
+	CAPRSServerThread* m_server;
+	CAPRSIngestThread* m_ingest;
+	CAPRSKISSThread*   m_kiss;
+	CMetricsServerThread* m_metrics;
+	CAPRSTrace*        m_trace;
+	CAPRSFlightRecorder* m_recorder;
+	std::atomic<bool>  m_dumpRequested;
+	bool               m_downlink;
+	CMutex             m_uplinkMutex;
+	unsigned int       m_duplicates;
+	unsigned int       m_digestsSent;
+	unsigned int       m_digestsReceived;
 
 	void writeJSONStatus(const std::string& status);
+	void writeJSONStats();
 
-	void writeAPRS(const std::string& message);
+	void writeAPRS(const char* topic, const unsigned char* message, unsigned int length, APRS_ORIGIN origin = APRS_ORIGIN::GATEWAY, unsigned long long received = 0ULL);
+	void uplink(const char* topic, const unsigned char* message, unsigned int length, APRS_ORIGIN origin, unsigned long long received);
 
-	static void onAPRS(const unsigned char* message, unsigned int length);
+	void readDigests(const unsigned char* message, unsigned int length);
+
+	void logValidatorStats() const;
+	void logSiteStats() const;
+	void logMQTTStats() const;
+	void logLatencyStats() const;
+
+	static void onAPRS(const char* topic, const unsigned char* message, unsigned int length);
+	static void onDownlink(const std::string& line);
+	static void onIngest(const char* source, const unsigned char* message, unsigned int length);
+	static void onKISS(const unsigned char* message, unsigned int length);
+	static void onServerUplink(const unsigned char* message, unsigned int length);
+	static void onLease(const char* topic, const unsigned char* message, unsigned int length);
+	static void onCommand(const char* topic, const unsigned char* message, unsigned int length);
+	static void onCluster(const char* topic, const unsigned char* message, unsigned int length);
 };
 
 #endif
@@ -0,0 +1,305 @@
+/*
+ *   Copyright (C) 2026 by Jonathan Naylor G4KLX
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program; if not, write to the Free Software
+ *   Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+
+#include "APRSIngestThread.h"
+#include "APRSWriterThread.h"
+#include "Metrics.h"
+#include "Log.h"
+
+#include <cassert>
+#include <cstdio>
+#include <cstring>
+
+#if !defined(_WIN32) && !defined(_WIN64)
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <netinet/in.h>
+#include <netdb.h>
+#include <unistd.h>
+#include <poll.h>
+#include <errno.h>
+#endif
+
+// The most datagrams read by each call
+const unsigned int INGEST_BATCH = 32U;
+
+CAPRSIngestThread::CAPRSIngestThread(const std::string& unixPath, const std::string& udpAddress, unsigned short udpPort) :
+CThread(),
+m_unixPath(unixPath),
+m_udpAddress(udpAddress),
+m_udpPort(udpPort),
+m_unixFd(-1),
+m_udpFd(-1),
+m_exit(false),
+m_callback(nullptr),
+m_buffers(nullptr),
+m_received(0U),
+m_batches(0U),
+m_truncated(0U)
+{
+	assert(!unixPath.empty() || udpPort > 0U);
+
+	m_buffers = new unsigned char[INGEST_BATCH * FRAME_BUFFER_SIZE];
+}
+
+CAPRSIngestThread::~CAPRSIngestThread()
+{
+	delete[] m_buffers;
+}
+
+void CAPRSIngestThread::setCallback(IngestFrameCallback cb)
+{
+	m_callback = cb;
+}
+
+unsigned int CAPRSIngestThread::getReceived() const
+{
+	return m_received.load(std::memory_order_relaxed);
+}
+
+unsigned int CAPRSIngestThread::getBatches() const
+{
+	return m_batches.load(std::memory_order_relaxed);
+}
+
+unsigned int CAPRSIngestThread::getTruncated() const
+{
+	return m_truncated.load(std::memory_order_relaxed);
+}
+
+#if !defined(_WIN32) && !defined(_WIN64)
+
+bool CAPRSIngestThread::start()
+{
+	if (!m_unixPath.empty()) {
+		bool ret = openUnix();
+		if (!ret)
+			return false;
+	}
+
+	if (m_udpPort > 0U) {
+		bool ret = openUDP();
+		if (!ret) {
+			if (m_unixFd >= 0) {
+				::close(m_unixFd);
+				::unlink(m_unixPath.c_str());
+				m_unixFd = -1;
+			}
+			return false;
+		}
+	}
+
+	run();
+
+	return true;
+}
+
+bool CAPRSIngestThread::openUnix()
+{
+	struct sockaddr_un addr;
+	if (m_unixPath.size() >= sizeof(addr.sun_path)) {
+		LogError("The ingest socket path %s is too long", m_unixPath.c_str());
+		return false;
+	}
+
+	m_unixFd = ::socket(AF_UNIX, SOCK_DGRAM | SOCK_CLOEXEC, 0);
+	if (m_unixFd < 0) {
+		LogError("Cannot create the ingest Unix socket, err=%d", errno);
+		return false;
+	}
+
+	::memset(&addr, 0x00, sizeof(addr));
+	addr.sun_family = AF_UNIX;
+	::strcpy(addr.sun_path, m_unixPath.c_str());
+
+	// Remove any socket left by a previous run
+	::unlink(m_unixPath.c_str());
+
+	if (::bind(m_unixFd, (struct sockaddr*)&addr, sizeof(addr)) < 0) {
+		LogError("Cannot bind the ingest Unix socket to %s, err=%d", m_unixPath.c_str(), errno);
+		::close(m_unixFd);
+		m_unixFd = -1;
+		return false;
+	}
+
+	LogMessage("Ingesting APRS frames on %s", m_unixPath.c_str());
+
+	return true;
+}
+
+bool CAPRSIngestThread::openUDP()
+{
+	char port[10U];
+	::sprintf(port, "%u", m_udpPort);
+
+	struct addrinfo hints;
+	::memset(&hints, 0x00, sizeof(hints));
+	hints.ai_family   = AF_UNSPEC;
+	hints.ai_socktype = SOCK_DGRAM;
+	hints.ai_flags    = AI_PASSIVE | AI_NUMERICSERV;
+
+	struct addrinfo* res = nullptr;
+	int err = ::getaddrinfo(m_udpAddress.empty() ? nullptr : m_udpAddress.c_str(), port, &hints, &res);
+	if (err != 0) {
+		LogError("Cannot find address for the ingest UDP socket %s, err=%d", m_udpAddress.c_str(), err);
+		return false;
+	}
+
+	m_udpFd = ::socket(res->ai_family, SOCK_DGRAM | SOCK_CLOEXEC, 0);
+	if (m_udpFd < 0) {
+		LogError("Cannot create the ingest UDP socket, err=%d", errno);
+		::freeaddrinfo(res);
+		return false;
+	}
+
+	if (::bind(m_udpFd, res->ai_addr, res->ai_addrlen) < 0) {
+		LogError("Cannot bind the ingest UDP socket to port %u, err=%d", m_udpPort, errno);
+		::freeaddrinfo(res);
+		::close(m_udpFd);
+		m_udpFd = -1;
+		return false;
+	}
+
+	::freeaddrinfo(res);
+
+	LogMessage("Ingesting APRS frames on UDP port %u", m_udpPort);
+
+	return true;
+}
+
+void CAPRSIngestThread::entry()
+{
+	LogMessage("Starting the APRS ingest thread");
+
+	struct pollfd fds[2U];
+	unsigned int n = 0U;
+
+	if (m_unixFd >= 0) {
+		fds[n].fd     = m_unixFd;
+		fds[n].events = POLLIN;
+		n++;
+	}
+
+	if (m_udpFd >= 0) {
+		fds[n].fd     = m_udpFd;
+		fds[n].events = POLLIN;
+		n++;
+	}
+
+	while (!m_exit) {
+		// Wake up regularly to check for the thread being stopped
+		int ret = ::poll(fds, n, 500);
+		if (ret < 0) {
+			if (errno == EINTR)
+				continue;
+
+			LogError("Error from poll in the APRS ingest thread, err=%d", errno);
+			break;
+		}
+
+		for (unsigned int i = 0U; i < n; i++) {
+			if ((fds[i].revents & POLLIN) != 0)
+				receive(fds[i].fd, fds[i].fd == m_unixFd ? "unix" : "udp");
+		}
+	}
+
+	if (m_unixFd >= 0) {
+		::close(m_unixFd);
+		::unlink(m_unixPath.c_str());
+	}
+
+	if (m_udpFd >= 0)
+		::close(m_udpFd);
+
+	LogMessage("Stopping the APRS ingest thread");
+}
+
+void CAPRSIngestThread::receive(int fd, const char* source)
+{
+	struct mmsghdr msgs[INGEST_BATCH];
+	struct iovec   iovecs[INGEST_BATCH];
+
+	::memset(msgs, 0x00, sizeof(msgs));
+
+	for (unsigned int i = 0U; i < INGEST_BATCH; i++) {
+		iovecs[i].iov_base = m_buffers + i * FRAME_BUFFER_SIZE;
+		iovecs[i].iov_len  = FRAME_BUFFER_SIZE;
+
+		msgs[i].msg_hdr.msg_iov    = &iovecs[i];
+		msgs[i].msg_hdr.msg_iovlen = 1U;
+	}
+
+	// Keep reading while there are full batches waiting
+	for (;;) {
+		int n = ::recvmmsg(fd, msgs, INGEST_BATCH, MSG_DONTWAIT, nullptr);
+		if (n <= 0) {
+			if (n < 0 && errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)
+				LogError("Error reading from the %s ingest socket, err=%d", source, errno);
+			return;
+		}
+
+		m_batches.fetch_add(1U, std::memory_order_relaxed);
+
+		for (int i = 0; i < n; i++) {
+			// Truncated frames are too long to be valid
+			if ((msgs[i].msg_hdr.msg_flags & MSG_TRUNC) != 0) {
+				LogDebug("Rejected APRS frame from %s ingest, too long", source);
+				m_truncated.fetch_add(1U, std::memory_order_relaxed);
+
+				CMetrics::increment(METRIC::FRAMES_IN);
+				CMetrics::increment(METRIC::DROPPED_INVALID);
+				continue;
+			}
+
+			m_received.fetch_add(1U, std::memory_order_relaxed);
+
+			if (m_callback != nullptr)
+				m_callback(source, m_buffers + i * FRAME_BUFFER_SIZE, msgs[i].msg_len);
+		}
+
+		if ((unsigned int)n < INGEST_BATCH)
+			return;
+	}
+}
+
+void CAPRSIngestThread::stop()
+{
+	m_exit = true;
+
+	wait();
+}
+
+#else
+
+bool CAPRSIngestThread::start()
+{
+	LogError("APRS frame ingestion is not available on Windows");
+
+	return false;
+}
+
+void CAPRSIngestThread::entry()
+{
+}
+
+void CAPRSIngestThread::stop()
+{
+}
+
+#endif
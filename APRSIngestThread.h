@@ -0,0 +1,68 @@
+/*
+ *   Copyright (C) 2026 by Jonathan Naylor G4KLX
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program; if not, write to the Free Software
+ *   Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+
+#if !defined(APRSIngestThread_H)
+#define	APRSIngestThread_H
+
+#include "Thread.h"
+
+#include <atomic>
+#include <string>
+
+typedef void (*IngestFrameCallback)(const char* source, const unsigned char* data, unsigned int length);
+
+// Takes frames from producers on the same host without going through the
+// MQTT broker. Each datagram holds one TNC2 frame and the datagrams are read
+// in batches. Unix domain sockets and recvmmsg are only available on Linux.
+class CAPRSIngestThread : public CThread {
+public:
+	CAPRSIngestThread(const std::string& unixPath, const std::string& udpAddress, unsigned short udpPort);
+	virtual ~CAPRSIngestThread();
+
+	bool start();
+
+	void setCallback(IngestFrameCallback cb);
+
+	virtual void entry();
+
+	void stop();
+
+	unsigned int getReceived() const;
+	unsigned int getBatches() const;
+	unsigned int getTruncated() const;
+
+private:
+	std::string               m_unixPath;
+	std::string               m_udpAddress;
+	unsigned short            m_udpPort;
+	int                       m_unixFd;
+	int                       m_udpFd;
+	bool                      m_exit;
+	IngestFrameCallback       m_callback;
+	unsigned char*            m_buffers;
+	std::atomic<unsigned int> m_received;
+	std::atomic<unsigned int> m_batches;
+	std::atomic<unsigned int> m_truncated;
+
+	bool openUnix();
+	bool openUDP();
+	void receive(int fd, const char* source);
+};
+
+#endif
@@ -0,0 +1,318 @@
+/*
+ *   Copyright (C) 2026 by Jonathan Naylor G4KLX
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program; if not, write to the Free Software
+ *   Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+
+#include "APRSKISSThread.h"
+#include "APRSWriterThread.h"
+#include "Log.h"
+
+#include <cassert>
+#include <cstring>
+
+const unsigned char KISS_FEND  = 0xC0U;
+const unsigned char KISS_FESC  = 0xDBU;
+const unsigned char KISS_TFEND = 0xDCU;
+const unsigned char KISS_TFESC = 0xDDU;
+
+const unsigned char KISS_DATA  = 0x00U;
+
+const unsigned char AX25_UI       = 0x03U;
+const unsigned char AX25_PID_NONE = 0xF0U;
+
+const unsigned int AX25_ADDRESS_LENGTH = 7U;
+const unsigned int AX25_MAX_ADDRESSES  = 10U;
+
+// Longer than any AX.25 frame that could be converted into a valid TNC2 frame
+const unsigned int KISS_MAX_FRAME = 1024U;
+
+const unsigned int KISS_RETRY_TIME = 10000U;
+
+// The AX.25 address bytes, which are ASCII shifted up one bit, mapped to ASCII.
+// Spaces pad the callsign and zero marks a byte that can't be in a callsign.
+static unsigned char CALLSIGN_TABLE[256U];
+
+static const char* SSID_TEXT[16U] = {
+	"",    "-1",  "-2",  "-3",  "-4",  "-5",  "-6",  "-7",
+	"-8",  "-9",  "-10", "-11", "-12", "-13", "-14", "-15"
+};
+
+static struct CCallsignTable {
+	CCallsignTable()
+	{
+		for (unsigned int i = 0U; i < 256U; i++) {
+			unsigned char c = (unsigned char)(i >> 1);
+
+			if ((i & 0x01U) == 0x00U && ((c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') || c == ' '))
+				CALLSIGN_TABLE[i] = c;
+			else
+				CALLSIGN_TABLE[i] = 0x00U;
+		}
+	}
+} callsignTable;
+
+CAPRSKISSThread::CAPRSKISSThread(const std::string& address, unsigned short port) :
+CThread(),
+m_socket(address, port),
+m_exit(false),
+m_callback(nullptr),
+m_frame(nullptr),
+m_length(0U),
+m_escape(false),
+m_frames(0U),
+m_invalid(0U)
+{
+	assert(!address.empty());
+	assert(port > 0U);
+
+	m_frame = new unsigned char[KISS_MAX_FRAME];
+}
+
+CAPRSKISSThread::~CAPRSKISSThread()
+{
+	delete[] m_frame;
+}
+
+bool CAPRSKISSThread::start()
+{
+	run();
+
+	return true;
+}
+
+void CAPRSKISSThread::setCallback(KISSFrameCallback cb)
+{
+	m_callback = cb;
+}
+
+unsigned int CAPRSKISSThread::getFrames() const
+{
+	return m_frames;
+}
+
+unsigned int CAPRSKISSThread::getInvalid() const
+{
+	return m_invalid;
+}
+
+void CAPRSKISSThread::entry()
+{
+	LogMessage("Starting the KISS thread");
+
+	bool connected = false;
+
+	while (!m_exit) {
+		if (!connected) {
+			connected = m_socket.open();
+			if (!connected) {
+				LogError("Cannot connect to the KISS TNC, retrying in %u seconds", KISS_RETRY_TIME / 1000U);
+
+				for (unsigned int i = 0U; i < KISS_RETRY_TIME && !m_exit; i += 100U)
+					sleep(100U);
+
+				continue;
+			}
+
+			LogMessage("Connected to the KISS TNC");
+
+			m_length = 0U;
+			m_escape = false;
+		}
+
+		// Read whatever is available, the frames are picked out of the stream as it arrives
+		unsigned char buffer[1024U];
+		int n = m_socket.read(buffer, sizeof(buffer), 1U);
+		if (n < 0) {
+			LogError("The connection to the KISS TNC has been lost");
+			m_socket.close();
+			connected = false;
+			continue;
+		}
+
+		if (n > 0)
+			process(buffer, (unsigned int)n);
+	}
+
+	if (connected)
+		m_socket.close();
+
+	LogMessage("Stopping the KISS thread");
+}
+
+void CAPRSKISSThread::stop()
+{
+	m_exit = true;
+
+	wait();
+}
+
+void CAPRSKISSThread::process(const unsigned char* data, unsigned int length)
+{
+	assert(data != nullptr);
+
+	for (unsigned int i = 0U; i < length; i++) {
+		unsigned char c = data[i];
+
+		if (c == KISS_FEND) {
+			if (m_length > 0U)
+				frame();
+
+			m_length = 0U;
+			m_escape = false;
+			continue;
+		}
+
+		if (m_escape) {
+			if (c == KISS_TFEND)
+				c = KISS_FEND;
+			else if (c == KISS_TFESC)
+				c = KISS_FESC;
+
+			m_escape = false;
+		} else if (c == KISS_FESC) {
+			m_escape = true;
+			continue;
+		}
+
+		// An overlong frame is dropped when the next FEND arrives
+		if (m_length < KISS_MAX_FRAME)
+			m_frame[m_length++] = c;
+	}
+}
+
+void CAPRSKISSThread::frame()
+{
+	// Only data frames are wanted, from any port
+	if ((m_frame[0U] & 0x0FU) != KISS_DATA)
+		return;
+
+	if (m_length >= KISS_MAX_FRAME) {
+		m_invalid++;
+		return;
+	}
+
+	unsigned char text[FRAME_BUFFER_SIZE];
+	unsigned int length = decode(m_frame + 1U, m_length - 1U, text, FRAME_BUFFER_SIZE);
+	if (length == 0U) {
+		m_invalid++;
+		return;
+	}
+
+	m_frames++;
+
+	if (m_callback != nullptr)
+		m_callback(text, length);
+}
+
+unsigned int CAPRSKISSThread::decodeCallsign(const unsigned char* data, unsigned char* text)
+{
+	assert(data != nullptr);
+	assert(text != nullptr);
+
+	unsigned int n = 0U;
+	for (unsigned int i = 0U; i < 6U; i++) {
+		unsigned char c = CALLSIGN_TABLE[data[i]];
+		if (c == 0x00U)
+			return 0U;
+
+		// Padding can only be at the end
+		if (c == ' ')
+			break;
+
+		text[n++] = c;
+	}
+
+	if (n == 0U)
+		return 0U;
+
+	const char* ssid = SSID_TEXT[(data[6U] >> 1) & 0x0FU];
+	while (*ssid != '\0')
+		text[n++] = *ssid++;
+
+	return n;
+}
+
+unsigned int CAPRSKISSThread::decode(const unsigned char* data, unsigned int length, unsigned char* text, unsigned int size)
+{
+	assert(data != nullptr);
+	assert(text != nullptr);
+
+	// Find the end of the addresses, marked by the low bit of the last SSID byte
+	unsigned int addresses = 0U;
+	while (addresses < AX25_MAX_ADDRESSES) {
+		unsigned int offset = addresses * AX25_ADDRESS_LENGTH;
+		if ((offset + AX25_ADDRESS_LENGTH) > length)
+			return 0U;
+
+		addresses++;
+
+		if ((data[offset + AX25_ADDRESS_LENGTH - 1U] & 0x01U) == 0x01U)
+			break;
+	}
+
+	if (addresses < 2U || (data[addresses * AX25_ADDRESS_LENGTH - 1U] & 0x01U) == 0x00U)
+		return 0U;
+
+	unsigned int pos = addresses * AX25_ADDRESS_LENGTH;
+	if ((pos + 2U) > length || data[pos] != AX25_UI || data[pos + 1U] != AX25_PID_NONE)
+		return 0U;
+
+	const unsigned char* info = data + pos + 2U;
+	unsigned int infoLength = length - pos - 2U;
+
+	// The longest header is ten callsigns of nine characters with separators
+	if ((AX25_MAX_ADDRESSES * 11U + infoLength + 1U) > size)
+		return 0U;
+
+	// The source, then the destination
+	unsigned int n = decodeCallsign(data + AX25_ADDRESS_LENGTH, text);
+	if (n == 0U)
+		return 0U;
+
+	text[n++] = '>';
+
+	unsigned int len = decodeCallsign(data, text + n);
+	if (len == 0U)
+		return 0U;
+	n += len;
+
+	// The digipeaters, the last one to have repeated the frame is marked
+	unsigned int last = 0U;
+	for (unsigned int i = 2U; i < addresses; i++) {
+		if ((data[i * AX25_ADDRESS_LENGTH + 6U] & 0x80U) == 0x80U)
+			last = i;
+	}
+
+	for (unsigned int i = 2U; i < addresses; i++) {
+		text[n++] = ',';
+
+		len = decodeCallsign(data + i * AX25_ADDRESS_LENGTH, text + n);
+		if (len == 0U)
+			return 0U;
+		n += len;
+
+		if (i == last)
+			text[n++] = '*';
+	}
+
+	text[n++] = ':';
+
+	::memcpy(text + n, info, infoLength);
+	n += infoLength;
+
+	return n;
+}
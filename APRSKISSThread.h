@@ -0,0 +1,67 @@
+/*
+ *   Copyright (C) 2026 by Jonathan Naylor G4KLX
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program; if not, write to the Free Software
+ *   Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+
+#if !defined(APRSKISSThread_H)
+#define	APRSKISSThread_H
+
+#include "TCPSocket.h"
+#include "Thread.h"
+
+#include <string>
+
+typedef void (*KISSFrameCallback)(const unsigned char* data, unsigned int length);
+
+// A client for a software TNC that offers KISS over TCP. The AX.25 UI frames
+// heard on RF are converted to TNC2 text and passed on for gating.
+class CAPRSKISSThread : public CThread {
+public:
+	CAPRSKISSThread(const std::string& address, unsigned short port);
+	virtual ~CAPRSKISSThread();
+
+	bool start();
+
+	void setCallback(KISSFrameCallback cb);
+
+	virtual void entry();
+
+	void stop();
+
+	unsigned int getFrames() const;
+	unsigned int getInvalid() const;
+
+	// Converts an AX.25 UI frame to TNC2 text, returns the length or zero if it isn't valid
+	static unsigned int decode(const unsigned char* data, unsigned int length, unsigned char* text, unsigned int size);
+
+private:
+	CTCPSocket        m_socket;
+	bool              m_exit;
+	KISSFrameCallback m_callback;
+	unsigned char*    m_frame;
+	unsigned int      m_length;
+	bool              m_escape;
+	unsigned int      m_frames;
+	unsigned int      m_invalid;
+
+	void process(const unsigned char* data, unsigned int length);
+	void frame();
+
+	static unsigned int decodeCallsign(const unsigned char* data, unsigned char* text);
+};
+
+#endif
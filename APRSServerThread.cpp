@@ -0,0 +1,707 @@
+/*
+ *   Copyright (C) 2026 by Jonathan Naylor G4KLX
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program; if not, write to the Free Software
+ *   Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+
+#include "APRSServerThread.h"
+#include "StopWatch.h"
+#include "Log.h"
+
+#include <cassert>
+#include <cctype>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#if !defined(_WIN32) && !defined(_WIN64)
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include <netdb.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#endif
+
+const unsigned int MAX_EVENTS = 64U;
+
+// The most lines from APRS-IS waiting to be sent to the clients
+const unsigned int MAX_PENDING = 1000U;
+
+const unsigned long long KEEPALIVE_TIME = 20000ULL;
+const unsigned long long LOGIN_TIME     = 30000ULL;
+
+CAPRSServerThread::CAPRSServerThread(const std::string& callsign, const std::string& address, unsigned short port, unsigned int maxClients, unsigned int bufferSize, const std::string& version) :
+CThread(),
+m_callsign(callsign),
+m_address(address),
+m_port(port),
+m_maxClients(maxClients),
+m_bufferSize(bufferSize),
+m_version(version),
+m_listenFd(-1),
+m_epollFd(-1),
+m_eventFd(-1),
+m_exit(false),
+m_clients(),
+m_mutex(),
+m_pending(),
+m_lines(),
+m_uplinkCallback(nullptr),
+m_clientCount(0U),
+m_connects(0U),
+m_evictions(0U),
+m_uplinked(0U),
+m_dropped(0U)
+{
+	assert(!callsign.empty());
+	assert(port > 0U);
+	assert(maxClients > 0U);
+	assert(bufferSize > 0U);
+}
+
+CAPRSServerThread::~CAPRSServerThread()
+{
+}
+
+void CAPRSServerThread::setUplinkCallback(ServerUplinkCallback cb)
+{
+	m_uplinkCallback = cb;
+}
+
+unsigned int CAPRSServerThread::getClients() const
+{
+	return m_clientCount.load(std::memory_order_relaxed);
+}
+
+unsigned int CAPRSServerThread::getConnects() const
+{
+	return m_connects.load(std::memory_order_relaxed);
+}
+
+unsigned int CAPRSServerThread::getEvictions() const
+{
+	return m_evictions.load(std::memory_order_relaxed);
+}
+
+unsigned int CAPRSServerThread::getUplinked() const
+{
+	return m_uplinked.load(std::memory_order_relaxed);
+}
+
+unsigned int CAPRSServerThread::getDropped() const
+{
+	return m_dropped.load(std::memory_order_relaxed);
+}
+
+int CAPRSServerThread::passcode(const std::string& callsign)
+{
+	std::string::size_type length = callsign.find('-');
+	if (length == std::string::npos)
+		length = callsign.size();
+
+	int hash = 0x73E2;
+
+	for (std::string::size_type i = 0U; i < length; i += 2U) {
+		hash ^= ::toupper(callsign[i]) << 8;
+		if ((i + 1U) < length)
+			hash ^= ::toupper(callsign[i + 1U]);
+	}
+
+	return hash & 0x7FFF;
+}
+
+void CAPRSServerThread::setFilter(CClient* client, char* text)
+{
+	assert(client != nullptr);
+	assert(text != nullptr);
+
+	client->m_filters.clear();
+
+	// Each filter is a type letter followed by its values, separated by slashes
+	char* save = nullptr;
+	for (char* p = ::strtok_r(text, " \t", &save); p != nullptr; p = ::strtok_r(nullptr, " \t", &save)) {
+		if (p[0U] == '\0' || p[1U] != '/')
+			continue;
+
+		CFilter filter;
+		filter.m_type = p[0U];
+
+		char* save2 = nullptr;
+		for (char* q = ::strtok_r(p + 2U, "/", &save2); q != nullptr; q = ::strtok_r(nullptr, "/", &save2)) {
+			std::string value(q);
+			for (std::string::iterator it = value.begin(); it != value.end(); ++it)
+				*it = ::toupper(*it);
+			filter.m_values.push_back(value);
+		}
+
+		client->m_filters.push_back(filter);
+	}
+}
+
+bool CAPRSServerThread::matches(const CClient* client, const char* text, unsigned int length)
+{
+	assert(client != nullptr);
+	assert(text != nullptr);
+
+	// Without a filter a client gets everything
+	if (client->m_filters.empty())
+		return true;
+
+	const char* gt = (const char*)::memchr(text, '>', length);
+	if (gt == nullptr)
+		return false;
+
+	size_t sourceLength = size_t(gt - text);
+
+	// Only the prefix (p/) and budlist (b/) filters are supported, the others never match
+	for (std::vector<CFilter>::const_iterator it = client->m_filters.cbegin(); it != client->m_filters.cend(); ++it) {
+		for (std::vector<std::string>::const_iterator it2 = (*it).m_values.cbegin(); it2 != (*it).m_values.cend(); ++it2) {
+			const std::string& value = *it2;
+
+			if ((*it).m_type == 'p') {
+				if (value.size() <= sourceLength && ::memcmp(value.c_str(), text, value.size()) == 0)
+					return true;
+			} else if ((*it).m_type == 'b') {
+				if (!value.empty() && value.back() == '*') {
+					if ((value.size() - 1U) <= sourceLength && ::memcmp(value.c_str(), text, value.size() - 1U) == 0)
+						return true;
+				} else if (value.size() == sourceLength && ::memcmp(value.c_str(), text, sourceLength) == 0) {
+					return true;
+				}
+			}
+		}
+	}
+
+	return false;
+}
+
+#if !defined(_WIN32) && !defined(_WIN64)
+
+bool CAPRSServerThread::start()
+{
+	char port[10U];
+	::sprintf(port, "%u", m_port);
+
+	struct addrinfo hints;
+	::memset(&hints, 0x00, sizeof(hints));
+	hints.ai_family   = AF_UNSPEC;
+	hints.ai_socktype = SOCK_STREAM;
+	hints.ai_flags    = AI_PASSIVE | AI_NUMERICSERV;
+
+	struct addrinfo* res = nullptr;
+	int err = ::getaddrinfo(m_address.empty() ? nullptr : m_address.c_str(), port, &hints, &res);
+	if (err != 0) {
+		LogError("Cannot find address for the APRS server %s, err=%d", m_address.c_str(), err);
+		return false;
+	}
+
+	m_listenFd = ::socket(res->ai_family, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+	if (m_listenFd < 0) {
+		LogError("Cannot create the APRS server socket, err=%d", errno);
+		::freeaddrinfo(res);
+		return false;
+	}
+
+	int reuse = 1;
+	::setsockopt(m_listenFd, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+
+	if (::bind(m_listenFd, res->ai_addr, res->ai_addrlen) < 0) {
+		LogError("Cannot bind the APRS server to port %u, err=%d", m_port, errno);
+		::freeaddrinfo(res);
+		::close(m_listenFd);
+		return false;
+	}
+
+	::freeaddrinfo(res);
+
+	if (::listen(m_listenFd, SOMAXCONN) < 0) {
+		LogError("Cannot listen on the APRS server socket, err=%d", errno);
+		::close(m_listenFd);
+		return false;
+	}
+
+	m_epollFd = ::epoll_create1(EPOLL_CLOEXEC);
+	m_eventFd = ::eventfd(0U, EFD_NONBLOCK | EFD_CLOEXEC);
+	if (m_epollFd < 0 || m_eventFd < 0) {
+		LogError("Cannot create the APRS server events, err=%d", errno);
+		::close(m_listenFd);
+		return false;
+	}
+
+	struct epoll_event ev;
+	::memset(&ev, 0x00, sizeof(ev));
+	ev.events  = EPOLLIN;
+	ev.data.fd = m_listenFd;
+	::epoll_ctl(m_epollFd, EPOLL_CTL_ADD, m_listenFd, &ev);
+
+	ev.data.fd = m_eventFd;
+	::epoll_ctl(m_epollFd, EPOLL_CTL_ADD, m_eventFd, &ev);
+
+	LogMessage("APRS server listening on port %u", m_port);
+
+	run();
+
+	return true;
+}
+
+void CAPRSServerThread::downlink(const std::string& line)
+{
+	unsigned int length = (unsigned int)line.size();
+	while (length > 0U && (line[length - 1U] == '\r' || line[length - 1U] == '\n'))
+		length--;
+
+	if (length == 0U)
+		return;
+
+	m_mutex.lock();
+	bool wake = m_pending.empty();
+	if (m_pending.size() < MAX_PENDING)
+		m_pending.push_back(line.substr(0U, length));
+	else
+		m_dropped.fetch_add(1U, std::memory_order_relaxed);
+	m_mutex.unlock();
+
+	// Only the first line needs to wake the server thread
+	if (wake) {
+		uint64_t value = 1U;
+		ssize_t ret = ::write(m_eventFd, &value, sizeof(value));
+		(void)ret;
+	}
+}
+
+void CAPRSServerThread::entry()
+{
+	LogMessage("Starting the APRS server thread");
+
+	unsigned long long lastKeepalive = CStopWatch::getMicroseconds() / 1000ULL;
+
+	while (!m_exit) {
+		struct epoll_event events[MAX_EVENTS];
+		int n = ::epoll_wait(m_epollFd, events, MAX_EVENTS, 1000);
+		if (n < 0 && errno != EINTR) {
+			LogError("Error from epoll in the APRS server, err=%d", errno);
+			break;
+		}
+
+		for (int i = 0; i < n; i++) {
+			int fd = events[i].data.fd;
+
+			if (fd == m_listenFd) {
+				accept();
+			} else if (fd == m_eventFd) {
+				uint64_t value;
+				ssize_t ret = ::read(m_eventFd, &value, sizeof(value));
+				(void)ret;
+
+				fanOut();
+			} else {
+				std::unordered_map<int, CClient*>::iterator it = m_clients.find(fd);
+				if (it == m_clients.end())
+					continue;
+
+				CClient* client = it->second;
+
+				if ((events[i].events & (EPOLLERR | EPOLLHUP)) != 0U) {
+					close(client);
+					continue;
+				}
+
+				if ((events[i].events & EPOLLOUT) != 0U)
+					flush(client);
+
+				if ((events[i].events & EPOLLIN) != 0U && !client->m_closing)
+					read(client);
+
+				if (client->m_closing)
+					close(client);
+			}
+		}
+
+		unsigned long long now = CStopWatch::getMicroseconds() / 1000ULL;
+		if ((now - lastKeepalive) >= KEEPALIVE_TIME) {
+			keepalive(now);
+			lastKeepalive = now;
+		}
+	}
+
+	while (!m_clients.empty())
+		close(m_clients.begin()->second);
+
+	::close(m_eventFd);
+	::close(m_epollFd);
+	::close(m_listenFd);
+
+	LogMessage("Stopping the APRS server thread");
+}
+
+void CAPRSServerThread::stop()
+{
+	m_exit = true;
+
+	uint64_t value = 1U;
+	ssize_t ret = ::write(m_eventFd, &value, sizeof(value));
+	(void)ret;
+
+	wait();
+}
+
+void CAPRSServerThread::accept()
+{
+	for (;;) {
+		struct sockaddr_storage addr;
+		socklen_t addrLength = sizeof(addr);
+
+		int fd = ::accept4(m_listenFd, (struct sockaddr*)&addr, &addrLength, SOCK_NONBLOCK | SOCK_CLOEXEC);
+		if (fd < 0) {
+			if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)
+				LogError("Error accepting an APRS server client, err=%d", errno);
+			return;
+		}
+
+		if (m_clients.size() >= m_maxClients) {
+			const char* full = "# server full\r\n";
+			ssize_t ret = ::send(fd, full, ::strlen(full), MSG_NOSIGNAL | MSG_DONTWAIT);
+			(void)ret;
+			::close(fd);
+			continue;
+		}
+
+		int noDelay = 1;
+		::setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &noDelay, sizeof(noDelay));
+
+		char address[INET6_ADDRSTRLEN];
+		if (addr.ss_family == AF_INET6)
+			::inet_ntop(AF_INET6, &((struct sockaddr_in6*)&addr)->sin6_addr, address, sizeof(address));
+		else
+			::inet_ntop(AF_INET, &((struct sockaddr_in*)&addr)->sin_addr, address, sizeof(address));
+
+		CClient* client = new CClient;
+		client->m_fd          = fd;
+		client->m_address     = address;
+		client->m_loggedIn    = false;
+		client->m_verified    = false;
+		client->m_inputLength = 0U;
+		client->m_discarding  = false;
+		client->m_outputStart = 0U;
+		client->m_writing     = false;
+		client->m_closing     = false;
+		client->m_time        = CStopWatch::getMicroseconds() / 1000ULL;
+
+		struct epoll_event ev;
+		::memset(&ev, 0x00, sizeof(ev));
+		ev.events  = EPOLLIN;
+		ev.data.fd = fd;
+		::epoll_ctl(m_epollFd, EPOLL_CTL_ADD, fd, &ev);
+
+		m_clients[fd] = client;
+		m_clientCount.store((unsigned int)m_clients.size(), std::memory_order_relaxed);
+		m_connects.fetch_add(1U, std::memory_order_relaxed);
+
+		LogMessage("APRS server client connected from %s", address);
+
+		char banner[100U];
+		::sprintf(banner, "# APRSGateway %s\r\n", m_version.c_str());
+		send(client, banner, (unsigned int)::strlen(banner));
+		flush(client);
+
+		if (client->m_closing)
+			close(client);
+	}
+}
+
+void CAPRSServerThread::read(CClient* client)
+{
+	assert(client != nullptr);
+
+	char buffer[1024U];
+	ssize_t n = ::recv(client->m_fd, buffer, sizeof(buffer), MSG_DONTWAIT);
+	if (n == 0) {
+		client->m_closing = true;
+		return;
+	}
+
+	if (n < 0) {
+		if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)
+			client->m_closing = true;
+		return;
+	}
+
+	for (ssize_t i = 0; i < n && !client->m_closing; i++) {
+		char c = buffer[i];
+
+		if (c == '\n') {
+			if (!client->m_discarding) {
+				client->m_input[client->m_inputLength] = '\0';
+				line(client, client->m_input);
+			}
+
+			client->m_inputLength = 0U;
+			client->m_discarding  = false;
+		} else if (c != '\r' && !client->m_discarding) {
+			// Overlong lines are thrown away, up to the end of the line
+			if (client->m_inputLength < (sizeof(client->m_input) - 1U)) {
+				client->m_input[client->m_inputLength++] = c;
+			} else {
+				client->m_inputLength = 0U;
+				client->m_discarding  = true;
+			}
+		}
+	}
+
+	flush(client);
+}
+
+void CAPRSServerThread::line(CClient* client, char* text)
+{
+	assert(client != nullptr);
+	assert(text != nullptr);
+
+	unsigned int length = (unsigned int)::strlen(text);
+	if (length == 0U)
+		return;
+
+	if (!client->m_loggedIn) {
+		if (::strncmp(text, "user ", 5U) == 0)
+			login(client, text);
+		return;
+	}
+
+	if (text[0U] == '#') {
+		char* filter = ::strstr(text, "filter");
+		if (filter != nullptr) {
+			setFilter(client, filter + 6U);
+			LogMessage("APRS server client %s changed its filter", client->m_callsign.c_str());
+		}
+		return;
+	}
+
+	// Only verified clients may send to APRS-IS
+	if (client->m_verified && m_uplinkCallback != nullptr) {
+		m_uplinkCallback((const unsigned char*)text, length);
+		m_uplinked.fetch_add(1U, std::memory_order_relaxed);
+	}
+}
+
+void CAPRSServerThread::login(CClient* client, char* text)
+{
+	assert(client != nullptr);
+	assert(text != nullptr);
+
+	// The filter takes up the rest of the line
+	char* filter = ::strstr(text, " filter ");
+	if (filter != nullptr) {
+		*filter = '\0';
+		setFilter(client, filter + 8U);
+	}
+
+	// user <callsign> pass <passcode> vers <software> <version>
+	int pass = -1;
+	char* save = nullptr;
+	for (char* p = ::strtok_r(text, " \t", &save); p != nullptr; p = ::strtok_r(nullptr, " \t", &save)) {
+		if (::strcmp(p, "user") == 0) {
+			char* callsign = ::strtok_r(nullptr, " \t", &save);
+			if (callsign != nullptr)
+				client->m_callsign = callsign;
+		} else if (::strcmp(p, "pass") == 0) {
+			char* passcode = ::strtok_r(nullptr, " \t", &save);
+			if (passcode != nullptr)
+				pass = ::atoi(passcode);
+		}
+	}
+
+	if (client->m_callsign.empty()) {
+		client->m_closing = true;
+		return;
+	}
+
+	for (std::string::iterator it = client->m_callsign.begin(); it != client->m_callsign.end(); ++it)
+		*it = ::toupper(*it);
+
+	client->m_loggedIn = true;
+	client->m_verified = pass >= 0 && pass == passcode(client->m_callsign);
+
+	LogMessage("APRS server client %s logged in from %s, %s", client->m_callsign.c_str(), client->m_address.c_str(), client->m_verified ? "verified" : "unverified");
+
+	char reply[150U];
+	::snprintf(reply, sizeof(reply), "# logresp %s %s, server %s\r\n", client->m_callsign.c_str(), client->m_verified ? "verified" : "unverified", m_callsign.c_str());
+	send(client, reply, (unsigned int)::strlen(reply));
+}
+
+void CAPRSServerThread::send(CClient* client, const char* text, unsigned int length)
+{
+	assert(client != nullptr);
+	assert(text != nullptr);
+
+	if (client->m_closing)
+		return;
+
+	// A client that can't keep up is disconnected rather than allowed to use more memory
+	if ((client->m_output.size() - client->m_outputStart + length) > m_bufferSize) {
+		LogMessage("APRS server client %s is too slow, disconnecting", client->m_callsign.c_str());
+		client->m_closing = true;
+		m_evictions.fetch_add(1U, std::memory_order_relaxed);
+		return;
+	}
+
+	client->m_output.append(text, length);
+}
+
+void CAPRSServerThread::flush(CClient* client)
+{
+	assert(client != nullptr);
+
+	while (!client->m_closing && client->m_outputStart < client->m_output.size()) {
+		ssize_t n = ::send(client->m_fd, client->m_output.data() + client->m_outputStart, client->m_output.size() - client->m_outputStart, MSG_NOSIGNAL | MSG_DONTWAIT);
+		if (n < 0) {
+			if (errno == EINTR)
+				continue;
+			if (errno != EAGAIN && errno != EWOULDBLOCK)
+				client->m_closing = true;
+			break;
+		}
+
+		client->m_outputStart += n;
+	}
+
+	bool writing = client->m_outputStart < client->m_output.size();
+
+	if (!writing) {
+		client->m_output.clear();
+		client->m_outputStart = 0U;
+	} else if (client->m_outputStart > (client->m_output.size() / 2U)) {
+		client->m_output.erase(0U, client->m_outputStart);
+		client->m_outputStart = 0U;
+	}
+
+	// Only ask to be told when the socket can be written to while there is something waiting
+	if (writing != client->m_writing && !client->m_closing) {
+		struct epoll_event ev;
+		::memset(&ev, 0x00, sizeof(ev));
+		ev.events  = writing ? (EPOLLIN | EPOLLOUT) : EPOLLIN;
+		ev.data.fd = client->m_fd;
+		::epoll_ctl(m_epollFd, EPOLL_CTL_MOD, client->m_fd, &ev);
+
+		client->m_writing = writing;
+	}
+}
+
+void CAPRSServerThread::fanOut()
+{
+	m_mutex.lock();
+	m_lines.swap(m_pending);
+	m_mutex.unlock();
+
+	for (std::deque<std::string>::const_iterator it = m_lines.cbegin(); it != m_lines.cend(); ++it) {
+		const std::string& line = *it;
+
+		for (std::unordered_map<int, CClient*>::iterator it2 = m_clients.begin(); it2 != m_clients.end(); ++it2) {
+			CClient* client = it2->second;
+
+			if (client->m_loggedIn && matches(client, line.c_str(), (unsigned int)line.size())) {
+				send(client, line.c_str(), (unsigned int)line.size());
+				send(client, "\r\n", 2U);
+			}
+		}
+	}
+
+	m_lines.clear();
+
+	// Send to each client once for the whole batch of lines
+	std::vector<CClient*> closing;
+	for (std::unordered_map<int, CClient*>::iterator it = m_clients.begin(); it != m_clients.end(); ++it) {
+		CClient* client = it->second;
+
+		flush(client);
+
+		if (client->m_closing)
+			closing.push_back(client);
+	}
+
+	for (std::vector<CClient*>::iterator it = closing.begin(); it != closing.end(); ++it)
+		close(*it);
+}
+
+void CAPRSServerThread::keepalive(unsigned long long now)
+{
+	char text[100U];
+	::sprintf(text, "# APRSGateway %s %s\r\n", m_version.c_str(), m_callsign.c_str());
+	unsigned int length = (unsigned int)::strlen(text);
+
+	std::vector<CClient*> closing;
+	for (std::unordered_map<int, CClient*>::iterator it = m_clients.begin(); it != m_clients.end(); ++it) {
+		CClient* client = it->second;
+
+		if (!client->m_loggedIn && (now - client->m_time) >= LOGIN_TIME) {
+			LogMessage("APRS server client from %s did not log in", client->m_address.c_str());
+			client->m_closing = true;
+		}
+
+		send(client, text, length);
+		flush(client);
+
+		if (client->m_closing)
+			closing.push_back(client);
+	}
+
+	for (std::vector<CClient*>::iterator it = closing.begin(); it != closing.end(); ++it)
+		close(*it);
+}
+
+void CAPRSServerThread::close(CClient* client)
+{
+	assert(client != nullptr);
+
+	if (client->m_loggedIn)
+		LogMessage("APRS server client %s from %s disconnected", client->m_callsign.c_str(), client->m_address.c_str());
+	else
+		LogMessage("APRS server client from %s disconnected", client->m_address.c_str());
+
+	::epoll_ctl(m_epollFd, EPOLL_CTL_DEL, client->m_fd, nullptr);
+	::close(client->m_fd);
+
+	m_clients.erase(client->m_fd);
+	m_clientCount.store((unsigned int)m_clients.size(), std::memory_order_relaxed);
+
+	delete client;
+}
+
+#else
+
+bool CAPRSServerThread::start()
+{
+	LogError("The APRS server is not available on Windows");
+
+	return false;
+}
+
+void CAPRSServerThread::downlink(const std::string& line)
+{
+}
+
+void CAPRSServerThread::entry()
+{
+}
+
+void CAPRSServerThread::stop()
+{
+}
+
+#endif
@@ -0,0 +1,121 @@
+/*
+ *   Copyright (C) 2026 by Jonathan Naylor G4KLX
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program; if not, write to the Free Software
+ *   Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+
+#if !defined(APRSServerThread_H)
+#define	APRSServerThread_H
+
+#include "Thread.h"
+#include "Mutex.h"
+
+#include <unordered_map>
+#include <atomic>
+#include <string>
+#include <vector>
+#include <deque>
+
+typedef void (*ServerUplinkCallback)(const unsigned char*, unsigned int);
+
+// A small APRS-IS server for local clients. Each client gets the frames
+// received from APRS-IS that match its filter, and frames from verified
+// clients are passed on for sending to APRS-IS. A single thread handles
+// every client using epoll, which is only available on Linux.
+class CAPRSServerThread : public CThread {
+public:
+	CAPRSServerThread(const std::string& callsign, const std::string& address, unsigned short port, unsigned int maxClients, unsigned int bufferSize, const std::string& version);
+	virtual ~CAPRSServerThread();
+
+	bool start();
+
+	// Called from the APRS Writer thread with each line from APRS-IS
+	void downlink(const std::string& line);
+
+	void setUplinkCallback(ServerUplinkCallback cb);
+
+	virtual void entry();
+
+	void stop();
+
+	unsigned int getClients() const;
+	unsigned int getConnects() const;
+	unsigned int getEvictions() const;
+	unsigned int getUplinked() const;
+	unsigned int getDropped() const;
+
+	// The APRS-IS passcode for a callsign
+	static int passcode(const std::string& callsign);
+
+private:
+	struct CFilter {
+		char                     m_type;
+		std::vector<std::string> m_values;
+	};
+
+	struct CClient {
+		int                  m_fd;
+		std::string          m_address;
+		bool                 m_loggedIn;
+		bool                 m_verified;
+		std::string          m_callsign;
+		std::vector<CFilter> m_filters;
+		char                 m_input[512U];
+		unsigned int         m_inputLength;
+		bool                 m_discarding;
+		std::string          m_output;
+		std::string::size_type m_outputStart;
+		bool                 m_writing;
+		bool                 m_closing;
+		unsigned long long   m_time;
+	};
+
+	std::string          m_callsign;
+	std::string          m_address;
+	unsigned short       m_port;
+	unsigned int         m_maxClients;
+	unsigned int         m_bufferSize;
+	std::string          m_version;
+	int                  m_listenFd;
+	int                  m_epollFd;
+	int                  m_eventFd;
+	bool                 m_exit;
+	std::unordered_map<int, CClient*> m_clients;
+	CMutex               m_mutex;
+	std::deque<std::string> m_pending;
+	std::deque<std::string> m_lines;
+	ServerUplinkCallback m_uplinkCallback;
+	std::atomic<unsigned int> m_clientCount;
+	std::atomic<unsigned int> m_connects;
+	std::atomic<unsigned int> m_evictions;
+	std::atomic<unsigned int> m_uplinked;
+	std::atomic<unsigned int> m_dropped;
+
+	void accept();
+	void read(CClient* client);
+	void flush(CClient* client);
+	void line(CClient* client, char* text);
+	void login(CClient* client, char* text);
+	void send(CClient* client, const char* text, unsigned int length);
+	void fanOut();
+	void keepalive(unsigned long long now);
+	void close(CClient* client);
+
+	static void setFilter(CClient* client, char* text);
+	static bool matches(const CClient* client, const char* text, unsigned int length);
+};
+
+#endif
@@ -0,0 +1,170 @@
+/*
+ *   Copyright (C) 2026 by Jonathan Naylor G4KLX
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program; if not, write to the Free Software
+ *   Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+#include "APRSSites.h"
+
+#include <cassert>
+#include <cstring>
+
+CAPRSSites::CAPRSSites(unsigned int queueSize) :
+m_queueSize(queueSize),
+m_sites(),
+m_count(0U)
+{
+	assert(queueSize > 0U);
+
+	for (unsigned int i = 0U; i < MAX_SITES; i++) {
+		m_sites[i].m_received = 0U;
+		m_sites[i].m_rejected = 0U;
+		m_sites[i].m_dropped  = 0U;
+		m_sites[i].m_sent     = 0U;
+		m_sites[i].m_queued   = 0U;
+	}
+}
+
+CAPRSSites::~CAPRSSites()
+{
+}
+
+unsigned int CAPRSSites::find(const char* topic)
+{
+	assert(topic != nullptr);
+
+	// The site is everything before the last level of the topic
+	const char* p = ::strrchr(topic, '/');
+	size_t length = (p != nullptr) ? size_t(p - topic) : ::strlen(topic);
+
+	unsigned int count = m_count.load(std::memory_order_acquire);
+	for (unsigned int i = 0U; i < count; i++) {
+		if (m_sites[i].m_name.size() == length && ::memcmp(m_sites[i].m_name.data(), topic, length) == 0)
+			return i;
+	}
+
+	// When the table is full, the remaining sites share the last entry
+	if (count == (MAX_SITES - 1U)) {
+		m_sites[count].m_name = "other";
+		m_count.store(MAX_SITES, std::memory_order_release);
+		return count;
+	} else if (count == MAX_SITES) {
+		return MAX_SITES - 1U;
+	}
+
+	m_sites[count].m_name.assign(topic, length);
+	m_count.store(count + 1U, std::memory_order_release);
+
+	return count;
+}
+
+bool CAPRSSites::hasShare(unsigned int site, unsigned int length) const
+{
+	assert(site < MAX_SITES);
+
+	// The queue is divided evenly between the sites that currently have frames in it
+	unsigned int active = 1U;
+	unsigned int count = m_count.load(std::memory_order_acquire);
+	for (unsigned int i = 0U; i < count; i++) {
+		if (i != site && m_sites[i].m_queued.load(std::memory_order_relaxed) > 0U)
+			active++;
+	}
+
+	return (m_sites[site].m_queued.load(std::memory_order_relaxed) + length) <= (m_queueSize / active);
+}
+
+void CAPRSSites::received(unsigned int site)
+{
+	assert(site < MAX_SITES);
+
+	m_sites[site].m_received.fetch_add(1U, std::memory_order_relaxed);
+}
+
+void CAPRSSites::rejected(unsigned int site)
+{
+	assert(site < MAX_SITES);
+
+	m_sites[site].m_rejected.fetch_add(1U, std::memory_order_relaxed);
+}
+
+void CAPRSSites::dropped(unsigned int site)
+{
+	assert(site < MAX_SITES);
+
+	m_sites[site].m_dropped.fetch_add(1U, std::memory_order_relaxed);
+}
+
+void CAPRSSites::queued(unsigned int site, unsigned int length)
+{
+	assert(site < MAX_SITES);
+
+	m_sites[site].m_queued.fetch_add(length, std::memory_order_relaxed);
+}
+
+void CAPRSSites::sent(unsigned int site, unsigned int length)
+{
+	assert(site < MAX_SITES);
+
+	m_sites[site].m_queued.fetch_sub(length, std::memory_order_relaxed);
+	m_sites[site].m_sent.fetch_add(1U, std::memory_order_relaxed);
+}
+
+void CAPRSSites::discarded(unsigned int site, unsigned int length)
+{
+	assert(site < MAX_SITES);
+
+	m_sites[site].m_queued.fetch_sub(length, std::memory_order_relaxed);
+	m_sites[site].m_dropped.fetch_add(1U, std::memory_order_relaxed);
+}
+
+unsigned int CAPRSSites::getCount() const
+{
+	return m_count.load(std::memory_order_acquire);
+}
+
+std::string CAPRSSites::getName(unsigned int site) const
+{
+	assert(site < MAX_SITES);
+
+	return m_sites[site].m_name;
+}
+
+unsigned int CAPRSSites::getReceived(unsigned int site) const
+{
+	assert(site < MAX_SITES);
+
+	return m_sites[site].m_received.load(std::memory_order_relaxed);
+}
+
+unsigned int CAPRSSites::getRejected(unsigned int site) const
+{
+	assert(site < MAX_SITES);
+
+	return m_sites[site].m_rejected.load(std::memory_order_relaxed);
+}
+
+unsigned int CAPRSSites::getDropped(unsigned int site) const
+{
+	assert(site < MAX_SITES);
+
+	return m_sites[site].m_dropped.load(std::memory_order_relaxed);
+}
+
+unsigned int CAPRSSites::getSent(unsigned int site) const
+{
+	assert(site < MAX_SITES);
+
+	return m_sites[site].m_sent.load(std::memory_order_relaxed);
+}
@@ -0,0 +1,70 @@
+/*
+ *   Copyright (C) 2026 by Jonathan Naylor G4KLX
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program; if not, write to the Free Software
+ *   Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+#if !defined(APRSSites_H)
+#define	APRSSites_H
+
+#include <atomic>
+#include <string>
+
+const unsigned int MAX_SITES = 64U;
+
+// The sites feeding the gateway, identified by the topic their frames arrive
+// on. New sites are added by whichever thread uplinks a frame, from MQTT, the
+// APRS server, ingest or KISS, always under the gateway's uplink lock. The
+// counters are updated from those threads and the writer thread.
+class CAPRSSites {
+public:
+	CAPRSSites(unsigned int queueSize);
+	~CAPRSSites();
+
+	unsigned int find(const char* topic);
+
+	// Whether the site may add a frame of this length to the shared queue
+	bool hasShare(unsigned int site, unsigned int length) const;
+
+	void received(unsigned int site);
+	void rejected(unsigned int site);
+	void dropped(unsigned int site);
+	void queued(unsigned int site, unsigned int length);
+	void sent(unsigned int site, unsigned int length);
+	void discarded(unsigned int site, unsigned int length);
+
+	unsigned int getCount() const;
+	std::string  getName(unsigned int site) const;
+	unsigned int getReceived(unsigned int site) const;
+	unsigned int getRejected(unsigned int site) const;
+	unsigned int getDropped(unsigned int site) const;
+	unsigned int getSent(unsigned int site) const;
+
+private:
+	struct CSite {
+		std::string               m_name;
+		std::atomic<unsigned int> m_received;
+		std::atomic<unsigned int> m_rejected;
+		std::atomic<unsigned int> m_dropped;
+		std::atomic<unsigned int> m_sent;
+		std::atomic<unsigned int> m_queued;
+	};
+
+	unsigned int              m_queueSize;
+	CSite                     m_sites[MAX_SITES];
+	std::atomic<unsigned int> m_count;
+};
+
+#endif
@@ -0,0 +1,187 @@
+/*
+ *   Copyright (C) 2026 by Jonathan Naylor G4KLX
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program; if not, write to the Free Software
+ *   Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+#include "APRSTrace.h"
+#include "StopWatch.h"
+#include "Log.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+#include <cstdlib>
+#include <cctype>
+
+CAPRSTrace::CAPRSTrace(bool enabled, unsigned int sample, unsigned int rate, const std::string& callsigns) :
+m_enabled(enabled),
+m_sample(sample),
+m_rate(rate),
+m_bucketRate(rate),
+m_bucket(rate, rate),
+m_count(0U),
+m_mutex(),
+m_callsigns(),
+m_callsignCount(0U),
+m_traced(0U),
+m_suppressed(0U)
+{
+	setCallsigns(callsigns);
+}
+
+CAPRSTrace::~CAPRSTrace()
+{
+}
+
+bool CAPRSTrace::isEnabled() const
+{
+	return m_enabled.load(std::memory_order_relaxed);
+}
+
+bool CAPRSTrace::isTraced(const unsigned char* data1, unsigned int length1, const unsigned char* data2, unsigned int length2)
+{
+	assert(data1 != nullptr);
+
+	if (!m_enabled.load(std::memory_order_relaxed))
+		return false;
+
+	if (m_callsignCount.load(std::memory_order_acquire) > 0U) {
+		// The source is everything before the '>'
+		char source[TRACE_CALLSIGN_LENGTH];
+		unsigned int n = 0U;
+		for (unsigned int i = 0U; i < (length1 + length2) && n < TRACE_CALLSIGN_LENGTH; i++) {
+			unsigned char c = (i < length1) ? data1[i] : data2[i - length1];
+			if (c == '>')
+				break;
+			source[n++] = char(c);
+		}
+
+		if (n == TRACE_CALLSIGN_LENGTH)
+			return false;
+
+		source[n] = '\0';
+
+		if (!isAllowed(source))
+			return false;
+	}
+
+	unsigned int sample = m_sample.load(std::memory_order_relaxed);
+	if (sample > 1U && (m_count++ % sample) != 0U)
+		return false;
+
+	// Rate changes are picked up here, so the bucket is only used by this thread
+	unsigned int rate = m_rate.load(std::memory_order_relaxed);
+	if (rate != m_bucketRate) {
+		m_bucket.setRate(rate, rate);
+		m_bucketRate = rate;
+	}
+
+	if (m_bucket.getDelay(1U, CStopWatch::getMicroseconds()) > 0ULL) {
+		m_suppressed++;
+		return false;
+	}
+
+	m_bucket.take(1U);
+	m_traced++;
+
+	return true;
+}
+
+bool CAPRSTrace::command(const unsigned char* message, unsigned int length)
+{
+	assert(message != nullptr);
+
+	std::string text((const char*)message, length);
+
+	size_t pos = text.find_first_of(' ');
+	std::string name  = text.substr(0U, pos);
+	std::string value = (pos == std::string::npos) ? std::string() : text.substr(pos + 1U);
+
+	if (name == "debug") {
+		m_enabled = (value == "on" || value == "1");
+		LogInfo("Debug tracing is %s", m_enabled ? "on" : "off");
+	} else if (name == "sample") {
+		m_sample = (unsigned int)::atoi(value.c_str());
+		LogInfo("Debug tracing one in %u frames", m_sample.load());
+	} else if (name == "rate") {
+		m_rate = (unsigned int)::atoi(value.c_str());
+		LogInfo("Debug tracing at most %u frames a second, 0=unlimited", m_rate.load());
+	} else if (name == "trace") {
+		setCallsigns(value);
+		if (value.empty())
+			LogInfo("Debug tracing all callsigns");
+		else
+			LogInfo("Debug tracing only %s", value.c_str());
+	} else {
+		return false;
+	}
+
+	return true;
+}
+
+unsigned int CAPRSTrace::getTraced() const
+{
+	return m_traced;
+}
+
+unsigned int CAPRSTrace::getSuppressed() const
+{
+	return m_suppressed;
+}
+
+void CAPRSTrace::setCallsigns(const std::string& callsigns)
+{
+	m_mutex.lock();
+
+	unsigned int count = 0U;
+
+	size_t start = 0U;
+	while (start < callsigns.size() && count < TRACE_MAX_CALLSIGNS) {
+		size_t end = callsigns.find_first_of(", ", start);
+		if (end == std::string::npos)
+			end = callsigns.size();
+
+		size_t length = end - start;
+		if (length > 0U && length < TRACE_CALLSIGN_LENGTH) {
+			std::string callsign = callsigns.substr(start, length);
+			std::transform(callsign.begin(), callsign.end(), callsign.begin(), ::toupper);
+			::strcpy(m_callsigns[count++], callsign.c_str());
+		}
+
+		start = end + 1U;
+	}
+
+	m_callsignCount.store(count, std::memory_order_release);
+
+	m_mutex.unlock();
+}
+
+bool CAPRSTrace::isAllowed(const char* source)
+{
+	assert(source != nullptr);
+
+	m_mutex.lock();
+
+	bool found = false;
+
+	unsigned int count = m_callsignCount.load(std::memory_order_relaxed);
+	for (unsigned int i = 0U; i < count && !found; i++)
+		found = ::strcmp(m_callsigns[i], source) == 0;
+
+	m_mutex.unlock();
+
+	return found;
+}
@@ -0,0 +1,69 @@
+/*
+ *   Copyright (C) 2026 by Jonathan Naylor G4KLX
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program; if not, write to the Free Software
+ *   Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+#if !defined(APRSTrace_H)
+#define	APRSTrace_H
+
+#include "TokenBucket.h"
+#include "Mutex.h"
+
+#include <atomic>
+#include <string>
+
+const unsigned int TRACE_MAX_CALLSIGNS = 16U;
+const unsigned int TRACE_CALLSIGN_LENGTH = 10U;
+
+// Decides which frames are dumped by the debug tracing. Frames can be limited
+// to a list of source callsigns, sampled one in N, and rate limited. The
+// settings are changed by commands from the MQTT thread while isTraced() is
+// called from the writer thread.
+class CAPRSTrace {
+public:
+	CAPRSTrace(bool enabled, unsigned int sample, unsigned int rate, const std::string& callsigns);
+	~CAPRSTrace();
+
+	bool isEnabled() const;
+
+	// The frame may be split in two, as it is in the queue
+	bool isTraced(const unsigned char* data1, unsigned int length1, const unsigned char* data2, unsigned int length2);
+
+	// Handles "debug on|off", "sample <n>", "rate <n>" and "trace [<callsign>,...]",
+	// returns false if the command isn't for us
+	bool command(const unsigned char* message, unsigned int length);
+
+	unsigned int getTraced() const;
+	unsigned int getSuppressed() const;
+
+private:
+	std::atomic<bool>         m_enabled;
+	std::atomic<unsigned int> m_sample;
+	std::atomic<unsigned int> m_rate;
+	unsigned int              m_bucketRate;
+	CTokenBucket              m_bucket;
+	unsigned int              m_count;
+	CMutex                    m_mutex;
+	char                      m_callsigns[TRACE_MAX_CALLSIGNS][TRACE_CALLSIGN_LENGTH];
+	std::atomic<unsigned int> m_callsignCount;
+	unsigned int              m_traced;
+	unsigned int              m_suppressed;
+
+	void setCallsigns(const std::string& callsigns);
+	bool isAllowed(const char* source);
+};
+
+#endif
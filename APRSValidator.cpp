@@ -0,0 +1,229 @@
+/*
+ *   Copyright (C) 2026 by Jonathan Naylor G4KLX
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program; if not, write to the Free Software
+ *   Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+#include "APRSValidator.h"
+
+#include <cassert>
+#include <cctype>
+#include <cstring>
+
+const unsigned int MAX_CALLSIGN_LENGTH = 9U;
+const unsigned int MAX_DIGIPEATERS     = 8U;
+
+const char* REASON_TEXT[] = {
+	"none",
+	"empty",
+	"too long",
+	"control characters",
+	"no header",
+	"bad source",
+	"bad destination",
+	"bad path",
+	"bad q construct",
+	"no gate",
+	"unverified",
+	"empty information field"
+};
+
+CAPRSValidator::CAPRSValidator(const std::string& callsign, unsigned int maxLength) :
+m_qConstruct(",qAR,"),
+m_qConstructClient(",qAC,"),
+m_maxLength(maxLength),
+m_accepted(0U),
+m_rejected()
+{
+	assert(!callsign.empty());
+	assert(maxLength > 0U);
+
+	m_qConstruct       += callsign;
+	m_qConstructClient += callsign;
+
+	for (unsigned int i = 0U; i < APRS_REJECT_COUNT; i++)
+		m_rejected[i] = 0U;
+}
+
+CAPRSValidator::~CAPRSValidator()
+{
+}
+
+APRS_REJECT CAPRSValidator::check(const unsigned char* data, unsigned int& length, bool& addQ, APRS_ORIGIN origin) const
+{
+	assert(data != nullptr);
+
+	addQ = false;
+
+	// Strip the line ending, the producers are not consistent about including one
+	while (length > 0U && (data[length - 1U] == '\r' || data[length - 1U] == '\n' || data[length - 1U] == 0x00U))
+		length--;
+
+	if (length == 0U)
+		return APRS_REJECT::EMPTY;
+
+	if (::memchr(data, '\r', length) != nullptr || ::memchr(data, '\n', length) != nullptr || ::memchr(data, 0x00, length) != nullptr)
+		return APRS_REJECT::CONTROL_CHARS;
+
+	const unsigned char* colon = (const unsigned char*)::memchr(data, ':', length);
+	if (colon == nullptr)
+		return APRS_REJECT::NO_HEADER;
+
+	unsigned int headerLength = (unsigned int)(colon - data);
+
+	const unsigned char* gt = (const unsigned char*)::memchr(data, '>', headerLength);
+	if (gt == nullptr)
+		return APRS_REJECT::NO_HEADER;
+
+	if (!isCallsign(data, (unsigned int)(gt - data)))
+		return APRS_REJECT::BAD_SOURCE;
+
+	if ((headerLength + 1U) == length)
+		return APRS_REJECT::EMPTY_INFO;
+
+	bool hasQ     = false;
+	bool hasTCPIP = false;
+	unsigned int digipeaters = 0U;
+
+	// The destination followed by the path elements
+	unsigned int n = 0U;
+	const unsigned char* p = gt + 1U;
+	while (p <= colon) {
+		const unsigned char* end = (const unsigned char*)::memchr(p, ',', colon - p);
+		if (end == nullptr)
+			end = colon;
+
+		unsigned int elementLength = (unsigned int)(end - p);
+
+		if (n == 0U) {
+			if (!isCallsign(p, elementLength))
+				return APRS_REJECT::BAD_DESTINATION;
+		} else if (hasQ) {
+			// Only the callsign of the gate may follow the q construct
+			if (end != colon || !isCallsign(p, elementLength))
+				return APRS_REJECT::BAD_Q_CONSTRUCT;
+		} else if (isQConstruct(p, elementLength)) {
+			if (end == colon || origin == APRS_ORIGIN::RF)
+				return APRS_REJECT::BAD_Q_CONSTRUCT;
+			hasQ = true;
+		} else {
+			if (isElement(p, elementLength, "NOGATE") || isElement(p, elementLength, "RFONLY"))
+				return APRS_REJECT::NO_GATE;
+
+			if (isElement(p, elementLength, "TCPXX"))
+				return APRS_REJECT::UNVERIFIED;
+
+			// Frames from the Internet that have been sent out on RF are not gated back
+			if (origin == APRS_ORIGIN::RF && isElement(p, elementLength, "TCPIP"))
+				return APRS_REJECT::NO_GATE;
+
+			if (!isPathElement(p, elementLength))
+				return APRS_REJECT::BAD_PATH;
+
+			if (isElement(p, elementLength, "TCPIP"))
+				hasTCPIP = true;
+
+			digipeaters++;
+			if (digipeaters > MAX_DIGIPEATERS)
+				return APRS_REJECT::BAD_PATH;
+		}
+
+		p = end + 1U;
+		n++;
+	}
+
+	// Frames that originated on the Internet are left for the server to add the q construct
+	addQ = !hasQ && !hasTCPIP;
+
+	unsigned int total = length + 2U;
+	if (addQ)
+		total += (unsigned int)m_qConstruct.size();
+
+	if (total > m_maxLength)
+		return APRS_REJECT::TOO_LONG;
+
+	return APRS_REJECT::NONE;
+}
+
+APRS_REJECT CAPRSValidator::validate(const unsigned char* data, unsigned int& length, bool& addQ, APRS_ORIGIN origin)
+{
+	assert(data != nullptr);
+
+	APRS_REJECT reason = check(data, length, addQ, origin);
+	if (reason != APRS_REJECT::NONE)
+		m_rejected[(unsigned int)reason]++;
+	else
+		m_accepted++;
+
+	return reason;
+}
+
+const std::string& CAPRSValidator::getQConstruct(APRS_ORIGIN origin) const
+{
+	return (origin == APRS_ORIGIN::CLIENT) ? m_qConstructClient : m_qConstruct;
+}
+
+unsigned int CAPRSValidator::getAccepted() const
+{
+	return m_accepted;
+}
+
+unsigned int CAPRSValidator::getRejected(APRS_REJECT reason) const
+{
+	return m_rejected[(unsigned int)reason];
+}
+
+const char* CAPRSValidator::getReasonText(APRS_REJECT reason)
+{
+	return REASON_TEXT[(unsigned int)reason];
+}
+
+bool CAPRSValidator::isCallsign(const unsigned char* data, unsigned int length)
+{
+	if (length == 0U || length > MAX_CALLSIGN_LENGTH)
+		return false;
+
+	if (data[0U] == '-' || data[length - 1U] == '-')
+		return false;
+
+	for (unsigned int i = 0U; i < length; i++) {
+		if (!::isalnum(data[i]) && data[i] != '-')
+			return false;
+	}
+
+	return true;
+}
+
+bool CAPRSValidator::isPathElement(const unsigned char* data, unsigned int length)
+{
+	// Digipeaters that have been used are marked with an asterisk
+	if (length > 1U && data[length - 1U] == '*')
+		length--;
+
+	return isCallsign(data, length);
+}
+
+bool CAPRSValidator::isQConstruct(const unsigned char* data, unsigned int length)
+{
+	return length == 3U && data[0U] == 'q' && data[1U] == 'A' && ::isalpha(data[2U]);
+}
+
+bool CAPRSValidator::isElement(const unsigned char* data, unsigned int length, const char* text)
+{
+	if (length > 0U && data[length - 1U] == '*')
+		length--;
+
+	return length == ::strlen(text) && ::memcmp(data, text, length) == 0;
+}
@@ -0,0 +1,83 @@
+/*
+ *   Copyright (C) 2026 by Jonathan Naylor G4KLX
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program; if not, write to the Free Software
+ *   Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+#if !defined(APRSValidator_H)
+#define	APRSValidator_H
+
+#include <string>
+
+enum class APRS_REJECT : unsigned int {
+	NONE,
+	EMPTY,
+	TOO_LONG,
+	CONTROL_CHARS,
+	NO_HEADER,
+	BAD_SOURCE,
+	BAD_DESTINATION,
+	BAD_PATH,
+	BAD_Q_CONSTRUCT,
+	NO_GATE,
+	UNVERIFIED,
+	EMPTY_INFO
+};
+
+const unsigned int APRS_REJECT_COUNT = 12U;
+
+// Where a frame has come from, which decides the checks and the q construct
+enum class APRS_ORIGIN : unsigned int {
+	GATEWAY,
+	CLIENT,
+	RF
+};
+
+class CAPRSValidator {
+public:
+	CAPRSValidator(const std::string& callsign, unsigned int maxLength);
+	~CAPRSValidator();
+
+	// Checks a TNC2 format frame. On success, length is the size of the frame
+	// without its line ending and addQ is true when the q construct needs to
+	// be appended to the path. Frames heard directly on RF must not have come
+	// from the Internet.
+	APRS_REJECT check(const unsigned char* data, unsigned int& length, bool& addQ, APRS_ORIGIN origin = APRS_ORIGIN::GATEWAY) const;
+
+	// As check() but the result is counted in the statistics.
+	APRS_REJECT validate(const unsigned char* data, unsigned int& length, bool& addQ, APRS_ORIGIN origin = APRS_ORIGIN::GATEWAY);
+
+	// ",qAR,<callsign>" for frames gated from RF, or ",qAC,<callsign>" from a client connected to us
+	const std::string& getQConstruct(APRS_ORIGIN origin = APRS_ORIGIN::GATEWAY) const;
+
+	unsigned int getAccepted() const;
+	unsigned int getRejected(APRS_REJECT reason) const;
+
+	static const char* getReasonText(APRS_REJECT reason);
+
+private:
+	std::string  m_qConstruct;
+	std::string  m_qConstructClient;
+	unsigned int m_maxLength;
+	unsigned int m_accepted;
+	unsigned int m_rejected[APRS_REJECT_COUNT];
+
+	static bool isCallsign(const unsigned char* data, unsigned int length);
+	static bool isPathElement(const unsigned char* data, unsigned int length);
+	static bool isQConstruct(const unsigned char* data, unsigned int length);
+	static bool isElement(const unsigned char* data, unsigned int length, const char* text);
+};
+
+#endif
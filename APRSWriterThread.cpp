@@ -17,6 +17,11 @@
  */
 
 #include "APRSWriterThread.h"
+#include "Allocations.h"
+#include "Latency.h"
+#include "Metrics.h"
+#include "Profile.h"
+#include "StopWatch.h"
 #include "Utils.h"
 #include "Log.h"
 
@@ -25,6 +30,7 @@
 #include <cctype>
 #include <cstdint>
 #include <cstdio>
+#include <cstring>
 #include <cassert>
 
 // #define	DUMP_TX
@@ -33,19 +39,85 @@ const unsigned int CALLSIGN_LENGTH = 8U;
 
 const unsigned int APRS_TIMEOUT = 10U;
 
-CAPRSWriterThread::CAPRSWriterThread(const std::string& callsign, const std::string& password, const std::string& address, unsigned short port, const std::string& version, bool debug) :
+// The longest wait for data from APRS-IS before looking at the queue again
+const unsigned int READ_WAIT = 10U;
+
+// Roughly what fits into one TCP segment
+const unsigned int MAX_GATHER_BYTES = 1400U;
+
+const unsigned int QUEUE_SIZE = 32000U;
+
+// How long to stay on the TCP session after UDP submission has failed
+const unsigned int UDP_RETRY_TIME = 300U;
+
+// The oldest frame, in seconds, sent after connecting. APRS-IS drops a frame
+// repeated within 30 seconds, older ones would go out twice.
+const unsigned int MAX_REPLAY_TIME = 25U;
+
+// The most slow frame reports a second, so a stalled link doesn't flood MQTT
+const unsigned int SLOW_FRAME_RATE = 10U;
+
+// How often the health of the TCP session is looked at, in milliseconds
+const unsigned int TCP_SAMPLE_TIME = 1000U;
+
+// How long to wait for the socket send queue to drain before looking again
+const unsigned int SEND_QUEUE_WAIT = 5U;
+
+CAPRSWriterThread::CAPRSWriterThread(const std::string& callsign, const std::string& password, const std::string& address, unsigned short port, const std::string& filter, const std::string& version, bool debug) :
 CThread(),
 m_username(callsign),
 m_password(password),
+m_filter(filter),
 m_debug(debug),
+m_trace(nullptr),
+m_recorder(nullptr),
 m_socket(address, port),
-m_queue(2000U, "APRS Queue"),
+m_queue(QUEUE_SIZE, "APRS Queue"),
 m_exit(false),
 m_connected(false),
+m_enabled(true),
+m_warmTime(MAX_REPLAY_TIME * 1000ULL),
 m_reconnectTimer(1000U),
 m_tries(1U),
 m_aprsReadCallback(nullptr),
-m_version(version)
+m_sites(nullptr),
+m_version(version),
+m_allocating(0U),
+m_address(address),
+m_udpSocket(),
+m_udpAddr(),
+m_udpAddrLen(0U),
+m_udpPort(0U),
+m_udpRate(0U),
+m_udpActive(false),
+m_udpBucket(),
+m_udpRetryTimer(1000U, UDP_RETRY_TIME),
+m_login(),
+m_udpFrames(0U),
+m_udpFallbacks(0U),
+m_frameBucket(),
+m_byteBucket(),
+m_pacedSince(0ULL),
+m_pacedFrames(0U),
+m_pacingDelay(0ULL),
+m_maxPacingDelay(0ULL),
+m_line(),
+m_linger(0ULL),
+m_lastWrite(0ULL),
+m_lingerSince(0ULL),
+m_tcpFrames(0U),
+m_tcpWrites(0U),
+m_lingeredFrames(0U),
+m_lingerDelay(0ULL),
+m_maxLingerDelay(0ULL),
+m_slowTime(0ULL),
+m_slowBucket(SLOW_FRAME_RATE, SLOW_FRAME_RATE),
+m_slowFrames(0U),
+m_maxSendQueue(0U),
+m_sendQueueFull(false),
+m_sendQueueStalls(0U),
+m_lastSample(0ULL),
+m_retransmits(0U)
 {
 	assert(!callsign.empty());
 	assert(!password.empty());
@@ -71,17 +143,88 @@ bool CAPRSWriterThread::start()
 
 void CAPRSWriterThread::entry()
 {
+	PROFILE_THREAD("writer");
+
 	LogMessage("Starting the APRS Writer thread");
 
-	m_connected = connect();
-	if (!m_connected) {
-		LogError("Connect attempt to the APRS server has failed");
-		startReconnectionTimer();
+	if (m_udpPort > 0U) {
+		m_udpActive = openUDP();
+		if (!m_udpActive)
+			m_udpRetryTimer.start();
+	}
+
+	if (m_enabled.load(std::memory_order_acquire) && !m_udpActive) {
+		m_connected = connect();
+		if (!m_connected) {
+			LogError("Connect attempt to the APRS server has failed");
+			startReconnectionTimer();
+		}
 	}
 
 	try {
 		while (!m_exit) {
+			sampleTCP();
+
+			if (!m_enabled.load(std::memory_order_acquire)) {
+				if (m_connected) {
+					m_connected = false;
+					m_socket.close();
+					LogMessage("Disconnected from the APRS server");
+				}
+
+				m_reconnectTimer.stop();
+
+				trim();
+
+				sleep(100U);
+				continue;
+			}
+
+			if (m_udpPort > 0U && !m_udpActive && m_udpRetryTimer.isRunning() && m_udpRetryTimer.hasExpired()) {
+				m_udpRetryTimer.stop();
+
+				m_udpActive = openUDP();
+				if (m_udpActive)
+					LogMessage("Returning to UDP submission to the APRS server");
+				else
+					m_udpRetryTimer.start();
+			}
+
+			if (m_udpActive) {
+				if (m_connected) {
+					m_connected = false;
+					m_socket.close();
+					LogMessage("Disconnected from the APRS server");
+				}
+
+				m_reconnectTimer.stop();
+
+				if (!sendUDP()) {
+					// The frames stay in the queue to be sent over TCP
+					m_udpActive = false;
+					m_udpSocket.close();
+					m_udpFallbacks++;
+					LogError("UDP submission to the APRS server has failed, falling back to TCP for %u seconds", UDP_RETRY_TIME);
+					m_udpRetryTimer.start();
+					continue;
+				}
+
+				sleep(READ_WAIT);
+				continue;
+			}
+
+			// Connect straight away after being enabled
+			if (!m_connected && !m_reconnectTimer.isRunning()) {
+				m_connected = connect();
+				if (!m_connected) {
+					LogError("Connect attempt to the APRS server has failed");
+					startReconnectionTimer();
+				}
+			}
+
 			if (!m_connected) {
+				trim();
+
 				sleep(100U);
 				if (m_reconnectTimer.isRunning() && m_reconnectTimer.hasExpired()) {
 					m_reconnectTimer.stop();
@@ -97,41 +240,20 @@ void CAPRSWriterThread::entry()
 			if (m_connected) {
 				m_tries = 0U;
 
-				if (!m_queue.isEmpty()){
-					unsigned int length = 0U;
-					m_queue.getData((unsigned char*)&length, sizeof(unsigned int));
-
-					unsigned char p[FRAME_BUFFER_SIZE];
-					m_queue.getData(p, length);
-
-					if (m_debug)
-						CUtils::dump(1U, "APRS message", p, length);
-
-					bool ret = m_socket.write(p, length);
-					if (!ret) {
-						m_connected = false;
-						m_socket.close();
-						LogError("Connection to the APRS thread has failed");
-						startReconnectionTimer();
-					}
+				unsigned int wait = READ_WAIT;
+				if (!m_queue.isEmpty() && !sendTCP(wait)) {
+					// The frame stays in the queue to be sent after reconnecting
+					m_connected = false;
+					m_socket.close();
+					LogError("Connection to the APRS thread has failed");
+					startReconnectionTimer();
 				}
 
-				if (m_connected) {
-					std::string line;
-					int length = m_socket.readLine(line, APRS_TIMEOUT);
-
-					if (length < 0) {
-						m_connected = false;
-						m_socket.close();
-						LogError("Error when reading from the APRS server");
-						startReconnectionTimer();
-					}
-
-					if (length > 0 && line.at(0U) != '#'//check if we have something and if that something is an APRS frame
-						&& m_aprsReadCallback != nullptr) { //do we have someone wanting an APRS Frame?
-						// LogMessage("Received APRS Frame : %s", line.c_str());
-						m_aprsReadCallback(line);
-					}
+				if (m_connected && !readLines(wait)) {
+					m_connected = false;
+					m_socket.close();
+					LogError("Error when reading from the APRS server");
+					startReconnectionTimer();
 				}
 			}
 		}
@@ -139,10 +261,9 @@ void CAPRSWriterThread::entry()
 		if (m_connected)
 			m_socket.close();
 
-		while (!m_queue.isEmpty()) {
-			unsigned char p;
-			m_queue.getData(&p, 1U);
-		}
+		m_udpSocket.close();
+
+		m_queue.skip(m_queue.dataSize());
 	}
 	catch (std::exception& e) {
 		LogError("Exception raised in the APRS Writer thread - \"%s\"", e.what());
@@ -159,27 +280,222 @@ void CAPRSWriterThread::setReadAPRSCallback(ReadAPRSFrameCallback cb)
 	m_aprsReadCallback = cb;
 }
 
-bool CAPRSWriterThread::write(const std::string& message)
+void CAPRSWriterThread::setSites(CAPRSSites* sites)
 {
-	if (!m_connected)
-		return false;
+	m_sites = sites;
+}
 
-	unsigned int length = message.size();
+void CAPRSWriterThread::setTrace(CAPRSTrace* trace)
+{
+	m_trace = trace;
+}
 
-	unsigned int free = m_queue.freeSpace();
-	if (free < (length + sizeof(unsigned int)))
-		return false;
+void CAPRSWriterThread::setRecorder(CAPRSFlightRecorder* recorder)
+{
+	m_recorder = recorder;
+}
 
-	bool ret = m_queue.addData((unsigned char*)&length, sizeof(unsigned int));
-	if (!ret)
+void CAPRSWriterThread::setUDP(unsigned short port, unsigned int rate)
+{
+	assert(port > 0U);
+
+	m_udpPort = port;
+	m_udpRate = rate;
+
+	m_udpBucket.setRate(rate, UDP_BATCH);
+
+	// Every datagram starts with the login, there is no session
+	m_login = "user " + m_username + " pass " + m_password + " vers APRSGateway " + m_version + "\n";
+}
+
+void CAPRSWriterThread::setPacing(unsigned int frameRate, unsigned int byteRate, unsigned int burst)
+{
+	// The burst must be able to hold at least one frame
+	unsigned int frameBurst = (frameRate * burst) / 1000U;
+	m_frameBucket.setRate(frameRate, frameBurst);
+
+	unsigned int byteBurst = (byteRate * burst) / 1000U;
+	if (byteBurst < FRAME_BUFFER_SIZE)
+		byteBurst = FRAME_BUFFER_SIZE;
+	m_byteBucket.setRate(byteRate, byteBurst);
+}
+
+void CAPRSWriterThread::setLinger(unsigned int linger)
+{
+	m_linger = linger * 1000ULL;
+}
+
+void CAPRSWriterThread::setSlowFrames(unsigned int slowTime)
+{
+	m_slowTime = slowTime * 1000ULL;
+}
+
+void CAPRSWriterThread::setMaxSendQueue(unsigned int maxSendQueue)
+{
+	m_maxSendQueue = maxSendQueue;
+}
+
+void CAPRSWriterThread::setEnabled(bool enabled, unsigned int warmTime)
+{
+	if (warmTime > MAX_REPLAY_TIME)
+		warmTime = MAX_REPLAY_TIME;
+
+	// Set from the main thread, the warm time is published by storing the flag
+	m_warmTime.store(warmTime * 1000ULL, std::memory_order_relaxed);
+	m_enabled.store(enabled, std::memory_order_release);
+}
+
+void CAPRSWriterThread::trim()
+{
+	unsigned long long now      = CStopWatch::getMicroseconds();
+	unsigned long long warmTime = m_warmTime.load(std::memory_order_relaxed);
+
+	// Throw away the frames that the leader will have sent by now, or that
+	// APRS-IS would no longer see as duplicates
+	while (!m_queue.isEmpty()) {
+		APRSFrameHeader header;
+		m_queue.peek((unsigned char*)&header, sizeof(APRSFrameHeader));
+
+		if ((now - header.m_queued) < (warmTime * 1000ULL))
+			break;
+
+		m_queue.skip(sizeof(APRSFrameHeader) + header.m_length);
+
+		if (m_sites != nullptr)
+			m_sites->discarded(header.m_site, header.m_length);
+
+		if (m_recorder != nullptr)
+			m_recorder->record(FR_EVENT::DROP, header.m_id, header.m_site, header.m_length, FR_DROP::DISCARDED);
+
+		CMetrics::increment(METRIC::DROPPED_DISCARDED);
+	}
+}
+
+unsigned int CAPRSWriterThread::getQueueSize() const
+{
+	return QUEUE_SIZE;
+}
+
+unsigned int CAPRSWriterThread::getAllocatingFrames() const
+{
+	return m_allocating;
+}
+
+unsigned int CAPRSWriterThread::getUDPFrames() const
+{
+	return m_udpFrames;
+}
+
+unsigned int CAPRSWriterThread::getUDPFallbacks() const
+{
+	return m_udpFallbacks;
+}
+
+unsigned int CAPRSWriterThread::getTCPFrames() const
+{
+	return m_tcpFrames;
+}
+
+unsigned int CAPRSWriterThread::getTCPWrites() const
+{
+	return m_tcpWrites;
+}
+
+unsigned int CAPRSWriterThread::getLingeredFrames() const
+{
+	return m_lingeredFrames;
+}
+
+unsigned long long CAPRSWriterThread::getLingerDelay() const
+{
+	return m_lingerDelay;
+}
+
+unsigned long long CAPRSWriterThread::getMaxLingerDelay() const
+{
+	return m_maxLingerDelay;
+}
+
+unsigned int CAPRSWriterThread::getPacedFrames() const
+{
+	return m_pacedFrames;
+}
+
+unsigned long long CAPRSWriterThread::getPacingDelay() const
+{
+	return m_pacingDelay;
+}
+
+unsigned long long CAPRSWriterThread::getMaxPacingDelay() const
+{
+	return m_maxPacingDelay;
+}
+
+unsigned int CAPRSWriterThread::getSlowFrames() const
+{
+	return m_slowFrames;
+}
+
+unsigned int CAPRSWriterThread::getSendQueueStalls() const
+{
+	return m_sendQueueStalls;
+}
+
+bool CAPRSWriterThread::write(const APRSFramePart* parts, unsigned int count, unsigned int site, unsigned int id, unsigned long long received)
+{
+	assert(parts != nullptr);
+	assert(count > 0U);
+
+	// Frames are queued while not connected, as a standby does, ready to be
+	// sent on connecting. The writer throws away any that get too old.
+	PROFILE_ZONE(ZONE::ENQUEUE);
+
+	unsigned long long now = CStopWatch::getMicroseconds();
+
+	APRSFrameHeader header;
+	header.m_length   = 0U;
+	header.m_site     = site;
+	header.m_id       = id;
+	header.m_received = (received > 0ULL && received < now) ? received : now;
+	header.m_queued   = now;
+
+	for (unsigned int i = 0U; i < count; i++)
+		header.m_length += parts[i].m_length;
+
+	assert(header.m_length <= FRAME_BUFFER_SIZE);
+
+	if (!m_queue.hasSpace(header.m_length + sizeof(APRSFrameHeader)))
 		return false;
 
-	return m_queue.addData((unsigned char*)message.c_str(), length);
+	// Account for the frame before the writer thread can see it
+	if (m_sites != nullptr)
+		m_sites->queued(site, header.m_length);
+
+	// Copy the pieces into place and only then make the whole frame visible
+	unsigned int offset = 0U;
+	m_queue.putData(offset, (unsigned char*)&header, sizeof(APRSFrameHeader));
+	offset += sizeof(APRSFrameHeader);
+
+	for (unsigned int i = 0U; i < count; i++) {
+		m_queue.putData(offset, parts[i].m_data, parts[i].m_length);
+		offset += parts[i].m_length;
+	}
+
+	m_queue.commit(offset);
+
+	CLatency::record(LATENCY::INGRESS, now - header.m_received);
+
+	return true;
 }
 
 bool CAPRSWriterThread::isConnected() const
 {
-	return m_connected;
+	return m_connected || m_udpActive;
+}
+
+unsigned int CAPRSWriterThread::getQueueUsed() const
+{
+	return m_queue.dataSize();
 }
 
 void CAPRSWriterThread::stop()
@@ -192,9 +508,30 @@ void CAPRSWriterThread::stop()
 void CAPRSWriterThread::clock(unsigned int ms)
 {
 	m_reconnectTimer.clock(ms);
+	m_udpRetryTimer.clock(ms);
 }
 
 bool CAPRSWriterThread::connect()
+{
+	unsigned long long start = CStopWatch::getMicroseconds();
+
+	bool ret = login();
+	if (!ret) {
+		CMetrics::increment(METRIC::CONNECT_FAILURES);
+		return false;
+	}
+
+	CMetrics::increment(METRIC::CONNECTS);
+	CMetrics::observe(HISTOGRAM::CONNECT_TIME, CStopWatch::getMicroseconds() - start);
+
+	// The kernel counts the retransmits from zero for each connection
+	m_retransmits   = 0U;
+	m_sendQueueFull = false;
+
+	return true;
+}
+
+bool CAPRSWriterThread::login()
 {
 	bool ret = m_socket.open();
 	if (!ret)
@@ -217,10 +554,13 @@ bool CAPRSWriterThread::connect()
 
 	LogMessage("Received login banner : %s", CUtils::rtrim(serverResponse).c_str());
 
-	char connectString[200U];
-	::sprintf(connectString, "user %s pass %s vers APRSGateway %s\n", m_username.c_str(), m_password.c_str(), m_version.c_str());
+	// Built as a string, the filter from the ini file can be any length
+	std::string connectString = "user " + m_username + " pass " + m_password + " vers APRSGateway " + m_version;
+	if (!m_filter.empty())
+		connectString += " filter " + m_filter;
+	connectString += "\n";
 
-	ret = m_socket.writeLine(std::string(connectString));
+	ret = m_socket.writeLine(connectString);
 	if (!ret) {
 		m_socket.close();
 		return false;
@@ -242,9 +582,393 @@ bool CAPRSWriterThread::connect()
 
 	LogMessage("Connected to the APRS server");
 
+	m_line.clear();
+	m_pacedSince  = 0ULL;
+	m_lingerSince = 0ULL;
+
+	return true;
+}
+
+bool CAPRSWriterThread::openUDP()
+{
+	if (CUDPSocket::lookup(m_address, m_udpPort, m_udpAddr, m_udpAddrLen) != 0)
+		return false;
+
+	if (!m_udpSocket.open(m_udpAddr))
+		return false;
+
+	LogMessage("Using UDP submission to the APRS server on port %u", m_udpPort);
+
+	return true;
+}
+
+bool CAPRSWriterThread::sendUDP()
+{
+	unsigned long long now = CStopWatch::getMicroseconds();
+
+	// Work out how many frames the rate allows, a full batch may build up when idle
+	unsigned int allowed = UDP_BATCH;
+	if (m_udpBucket.isLimited())
+		allowed = m_udpBucket.getAvailable(now);
+
+	UDPDatagram datagrams[UDP_BATCH];
+	APRSFrameHeader headers[UDP_BATCH];
+
+	// Each datagram is the login line followed by a frame straight from the queue
+	unsigned int size   = m_queue.dataSize();
+	unsigned int offset = 0U;
+	unsigned int count  = 0U;
+	while (count < allowed && offset < size) {
+		PROFILE_ZONE(ZONE::DEQUEUE);
+
+		APRSFrameHeader& header = headers[count];
+		getHeader(offset, header);
+		offset += sizeof(APRSFrameHeader);
+
+		const unsigned char* p1 = nullptr;
+		const unsigned char* p2 = nullptr;
+		unsigned int length1 = 0U, length2 = 0U;
+
+		m_queue.getData(offset, header.m_length, p1, length1, p2, length2);
+		offset += header.m_length;
+
+		if (isTraced(p1, length1, p2, length2))
+			dump(p1, length1, p2, length2);
+
+		UDPDatagram& datagram = datagrams[count];
+		datagram.m_data[0U]   = (const unsigned char*)m_login.c_str();
+		datagram.m_length[0U] = (unsigned int)m_login.size();
+		datagram.m_data[1U]   = p1;
+		datagram.m_length[1U] = length1;
+		datagram.m_data[2U]   = p2;
+		datagram.m_length[2U] = length2;
+		datagram.m_count      = (length2 > 0U) ? 3U : 2U;
+
+		count++;
+	}
+
+	if (count == 0U)
+		return true;
+
+	int sent = m_udpSocket.write(datagrams, count, m_udpAddr, m_udpAddrLen);
+	if (sent <= 0)
+		return false;
+
+	unsigned long long done = CStopWatch::getMicroseconds();
+
+	for (int i = 0; i < sent; i++) {
+		m_queue.skip(sizeof(APRSFrameHeader) + headers[i].m_length);
+
+		if (m_sites != nullptr)
+			m_sites->sent(headers[i].m_site, headers[i].m_length);
+
+		if (m_recorder != nullptr)
+			m_recorder->record(FR_EVENT::SEND, headers[i].m_id, headers[i].m_site, headers[i].m_length);
+
+		countSent(headers[i], now, done);
+	}
+
+	m_udpFrames += (unsigned int)sent;
+	m_udpBucket.take((unsigned int)sent);
+
+	return true;
+}
+
+bool CAPRSWriterThread::sendTCP(unsigned int& wait)
+{
+	unsigned long long now = CStopWatch::getMicroseconds();
+	unsigned int size = m_queue.dataSize();
+
+	// Let APRS-IS catch up before handing the socket any more
+	if (m_maxSendQueue > 0U && m_socket.getSendQueue() >= m_maxSendQueue) {
+		if (!m_sendQueueFull) {
+			m_sendQueueFull = true;
+			m_sendQueueStalls++;
+			CMetrics::increment(METRIC::SEND_QUEUE_STALLS);
+		}
+
+		if (wait > SEND_QUEUE_WAIT)
+			wait = SEND_QUEUE_WAIT;
+
+		return true;
+	}
+
+	m_sendQueueFull = false;
+
+	APRSFrameHeader header;
+	getHeader(0U, header);
+
+	// A lone frame soon after the last write waits briefly for others to join it
+	if (m_linger > 0ULL && size == (sizeof(APRSFrameHeader) + header.m_length) && (now - m_lastWrite) < m_linger) {
+		if (m_lingerSince == 0ULL)
+			m_lingerSince = now;
+
+		unsigned long long elapsed = now - m_lingerSince;
+		if (elapsed < m_linger) {
+			unsigned int remaining = (unsigned int)((m_linger - elapsed + 999ULL) / 1000ULL);
+			if (remaining < wait)
+				wait = remaining;
+			return true;
+		}
+	}
+
+	// Gather as many queued frames as the pacing allows into one write
+	TCPBuffer buffers[TCP_MAX_BUFFERS];
+	APRSFrameHeader headers[TCP_MAX_BUFFERS / 2U];
+	unsigned int nBuffers = 0U;
+	unsigned int count    = 0U;
+	unsigned int offset   = 0U;
+	unsigned int bytes    = 0U;
+	unsigned long long delay = 0ULL;
+
+	while (count < (TCP_MAX_BUFFERS / 2U) && offset < size) {
+		PROFILE_ZONE(ZONE::DEQUEUE);
+
+		getHeader(offset, header);
+
+		if (count > 0U && (bytes + header.m_length) > MAX_GATHER_BYTES)
+			break;
+
+		delay = m_frameBucket.getDelay(1U, now);
+		unsigned long long byteDelay = m_byteBucket.getDelay(header.m_length, now);
+		if (byteDelay > delay)
+			delay = byteDelay;
+
+		if (delay > 0ULL)
+			break;
+
+		m_frameBucket.take(1U);
+		m_byteBucket.take(header.m_length);
+
+		// Send straight from the queue, the frame may be split by the end of it
+		const unsigned char* p1 = nullptr;
+		const unsigned char* p2 = nullptr;
+		unsigned int length1 = 0U, length2 = 0U;
+		m_queue.getData(offset + sizeof(APRSFrameHeader), header.m_length, p1, length1, p2, length2);
+
+		if (isTraced(p1, length1, p2, length2))
+			dump(p1, length1, p2, length2);
+
+		buffers[nBuffers].m_data   = p1;
+		buffers[nBuffers].m_length = length1;
+		nBuffers++;
+
+		if (length2 > 0U) {
+			buffers[nBuffers].m_data   = p2;
+			buffers[nBuffers].m_length = length2;
+			nBuffers++;
+		}
+
+		headers[count] = header;
+		offset += sizeof(APRSFrameHeader) + header.m_length;
+		bytes  += header.m_length;
+		count++;
+	}
+
+	// Hold the first frame back until both rates allow it, and wait no longer than needed
+	if (count == 0U) {
+		if (m_pacedSince == 0ULL)
+			m_pacedSince = now;
+
+		if (delay < (READ_WAIT * 1000ULL))
+			wait = (unsigned int)((delay + 999ULL) / 1000ULL);
+
+		return true;
+	}
+
+	unsigned long long allocations = CAllocations::getThreadCount();
+
+	if (!m_socket.write(buffers, nBuffers)) {
+		// The frames stay queued for the next connection, so they mustn't count against the rates yet
+		for (unsigned int i = 0U; i < count; i++) {
+			m_frameBucket.refund(1U);
+			m_byteBucket.refund(headers[i].m_length);
+		}
+
+		return false;
+	}
+
+	unsigned long long done = CStopWatch::getMicroseconds();
+
+	m_queue.skip(offset);
+
+	m_lastWrite = now;
+	m_tcpWrites++;
+	m_tcpFrames += count;
+
+	for (unsigned int i = 0U; i < count; i++) {
+		if (m_sites != nullptr)
+			m_sites->sent(headers[i].m_site, headers[i].m_length);
+
+		if (m_recorder != nullptr)
+			m_recorder->record(FR_EVENT::SEND, headers[i].m_id, headers[i].m_site, headers[i].m_length);
+
+		countSent(headers[i], now, done);
+	}
+
+	if (m_pacedSince != 0ULL) {
+		unsigned long long paced = now - m_pacedSince;
+
+		m_pacedFrames++;
+		m_pacingDelay += paced;
+		if (paced > m_maxPacingDelay)
+			m_maxPacingDelay = paced;
+
+		if (isDebug())
+			LogDebug("APRS frame held back by the pacing for %llu us", paced);
+
+		m_pacedSince = 0ULL;
+	}
+
+	if (m_lingerSince != 0ULL) {
+		unsigned long long lingered = now - m_lingerSince;
+
+		m_lingeredFrames++;
+		m_lingerDelay += lingered;
+		if (lingered > m_maxLingerDelay)
+			m_maxLingerDelay = lingered;
+
+		m_lingerSince = 0ULL;
+	}
+
+	if (CAllocations::getThreadCount() != allocations)
+		m_allocating += count;
+
+	// Look at the queue again straight away
+	wait = 0U;
+
+	return true;
+}
+
+// The frame was taken from the queue at dequeued and the socket had it by sent
+void CAPRSWriterThread::countSent(const APRSFrameHeader& header, unsigned long long dequeued, unsigned long long sent)
+{
+	CMetrics::increment(METRIC::FRAMES_OUT);
+	CMetrics::increment(METRIC::BYTES_SENT, header.m_length);
+	CMetrics::observe(HISTOGRAM::QUEUE_TIME, sent - header.m_queued);
+
+	CLatency::record(LATENCY::QUEUE, dequeued - header.m_queued);
+	CLatency::record(LATENCY::SEND, sent - dequeued);
+	CLatency::record(LATENCY::TOTAL, sent - header.m_received);
+
+	if (m_slowTime > 0ULL && (sent - header.m_received) > m_slowTime) {
+		m_slowFrames++;
+
+		if (m_slowBucket.getDelay(1U, sent) == 0ULL) {
+			m_slowBucket.take(1U);
+			writeSlowFrame(header, dequeued, sent);
+		}
+	}
+}
+
+void CAPRSWriterThread::writeSlowFrame(const APRSFrameHeader& header, unsigned long long dequeued, unsigned long long sent)
+{
+	nlohmann::json json;
+
+	json["timestamp"] = CUtils::createTimestamp();
+	json["id"]        = header.m_id;
+	json["site"]      = (m_sites != nullptr) ? m_sites->getName(header.m_site) : std::string();
+	json["length"]    = header.m_length;
+	json["transport"] = m_udpActive ? "udp" : "tcp";
+
+	// All in microseconds
+	json["ingress"] = header.m_queued - header.m_received;
+	json["queue"]   = dequeued - header.m_queued;
+	json["send"]    = sent - dequeued;
+	json["total"]   = sent - header.m_received;
+
+	WriteJSON("slow_frame", json);
+}
+
+bool CAPRSWriterThread::readLines(unsigned int wait)
+{
+	unsigned char buffer[1024U];
+	int length = m_socket.read(buffer, sizeof(buffer), 0U, wait);
+	if (length < 0)
+		return false;
+
+	if (length > 0)
+		CMetrics::increment(METRIC::BYTES_RECEIVED, (unsigned long long)length);
+
+	PROFILE_ZONE(ZONE::READ_LINES);
+
+	// Lines may arrive in pieces, so keep any partial line for the next read
+	for (int i = 0; i < length; i++) {
+		m_line.push_back(char(buffer[i]));
+
+		if (buffer[i] != '\n')
+			continue;
+
+		if (m_line.at(0U) != '#' && m_aprsReadCallback != nullptr)
+			m_aprsReadCallback(m_line);
+
+		m_line.clear();
+	}
+
+	// Throw away anything that could never be a frame
+	if (m_line.size() > FRAME_BUFFER_SIZE)
+		m_line.clear();
+
 	return true;
 }
 
+void CAPRSWriterThread::sampleTCP()
+{
+	unsigned long long now = CStopWatch::getMicroseconds();
+	if ((now - m_lastSample) < (TCP_SAMPLE_TIME * 1000ULL))
+		return;
+
+	m_lastSample = now;
+
+	TCPInfo info;
+	if (!m_connected || !m_socket.getInfo(info))
+		::memset(&info, 0x00, sizeof(TCPInfo));
+
+	if (info.m_retransmits > m_retransmits)
+		CMetrics::increment(METRIC::TCP_RETRANSMITS, info.m_retransmits - m_retransmits);
+	m_retransmits = info.m_retransmits;
+
+	CMetrics::set(GAUGE::TCP_RTT, info.m_rtt);
+	CMetrics::set(GAUGE::TCP_RTT_VAR, info.m_rttVar);
+	CMetrics::set(GAUGE::TCP_CWND, info.m_cwnd);
+	CMetrics::set(GAUGE::TCP_UNACKED, info.m_unacked);
+	CMetrics::set(GAUGE::TCP_SEND_QUEUE, info.m_sendQueue);
+	CMetrics::set(GAUGE::TCP_UNSENT, info.m_unsent);
+}
+
+void CAPRSWriterThread::getHeader(unsigned int offset, APRSFrameHeader& header) const
+{
+	const unsigned char* p1 = nullptr;
+	const unsigned char* p2 = nullptr;
+	unsigned int length1 = 0U, length2 = 0U;
+	m_queue.getData(offset, sizeof(APRSFrameHeader), p1, length1, p2, length2);
+
+	::memcpy(&header, p1, length1);
+	::memcpy((unsigned char*)&header + length1, p2, length2);
+}
+
+bool CAPRSWriterThread::isDebug() const
+{
+	return (m_trace != nullptr) ? m_trace->isEnabled() : m_debug;
+}
+
+bool CAPRSWriterThread::isTraced(const unsigned char* p1, unsigned int length1, const unsigned char* p2, unsigned int length2)
+{
+	return (m_trace != nullptr) ? m_trace->isTraced(p1, length1, p2, length2) : m_debug;
+}
+
+void CAPRSWriterThread::dump(const unsigned char* p1, unsigned int length1, const unsigned char* p2, unsigned int length2) const
+{
+	if (length2 == 0U) {
+		CUtils::dump(1U, "APRS message", p1, length1);
+	} else {
+		unsigned char p[FRAME_BUFFER_SIZE];
+		::memcpy(p, p1, length1);
+		::memcpy(p + length1, p2, length2);
+		CUtils::dump(1U, "APRS message", p, length1 + length2);
+	}
+}
+
 void CAPRSWriterThread::startReconnectionTimer()
 {
 	// Clamp at a ten minutes reconnect time
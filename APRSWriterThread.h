@@ -20,26 +20,48 @@
 #define	APRSWriterThread_H
 
 #include "TCPSocket.h"
+#include "UDPSocket.h"
 #include "RingBuffer.h"
+#include "TokenBucket.h"
+#include "APRSFlightRecorder.h"
+#include "APRSSites.h"
+#include "APRSTrace.h"
 #include "Timer.h"
 #include "Thread.h"
 
+#include <atomic>
 #include <string>
 
-const unsigned int FRAME_BUFFER_SIZE = 300U;
+const unsigned int FRAME_BUFFER_SIZE = 512U;
 
 typedef void (*ReadAPRSFrameCallback)(const std::string&);
 
+// Stored in the queue in front of each frame
+struct APRSFrameHeader {
+	unsigned int       m_length;
+	unsigned int       m_site;
+	unsigned int       m_id;
+	unsigned long long m_received;		// Microseconds, when the frame arrived
+	unsigned long long m_queued;		// Microseconds, when the frame was queued
+};
+
+// A piece of a frame, the pieces are joined together in the queue
+struct APRSFramePart {
+	const unsigned char* m_data;
+	unsigned int         m_length;
+};
+
 class CAPRSWriterThread : public CThread {
 public:
-	CAPRSWriterThread(const std::string& callsign, const std::string& password, const std::string& address, unsigned short port, const std::string& version, bool debug);
+	CAPRSWriterThread(const std::string& callsign, const std::string& password, const std::string& address, unsigned short port, const std::string& filter, const std::string& version, bool debug);
 	virtual ~CAPRSWriterThread();
 
 	virtual bool start();
 
 	virtual bool isConnected() const;
 
-	virtual bool write(const std::string& message);
+	// The received time is when the frame arrived, in microseconds, zero for now
+	virtual bool write(const APRSFramePart* parts, unsigned int count, unsigned int site = 0U, unsigned int id = 0U, unsigned long long received = 0ULL);
 
 	virtual void entry();
 
@@ -47,22 +69,139 @@ public:
 
 	void setReadAPRSCallback(ReadAPRSFrameCallback cb);
 
+	void setSites(CAPRSSites* sites);
+
+	// Chooses the frames that are dumped, rather than all of them when debugging
+	void setTrace(CAPRSTrace* trace);
+
+	// Records when each frame is sent, or thrown away by a standby
+	void setRecorder(CAPRSFlightRecorder* recorder);
+
+	// Submit frames to APRS-IS as UDP datagrams, at up to rate frames a second
+	// (zero is unpaced), falling back to the TCP session when sending fails.
+	void setUDP(unsigned short port, unsigned int rate);
+
+	// Limit the frames and bytes a second sent over the TCP session, allowing
+	// bursts of up to burst milliseconds worth. Zero is unlimited.
+	void setPacing(unsigned int frameRate, unsigned int byteRate, unsigned int burst);
+
+	// Frames that are queued together are sent in one write. A lone frame
+	// arriving within linger milliseconds of the last write waits that long
+	// for others to join it, otherwise it is sent straight away.
+	void setLinger(unsigned int linger);
+
+	// Publish the timings of frames that take longer than slowTime
+	// milliseconds to get from arrival to the socket. Zero is never.
+	void setSlowFrames(unsigned int slowTime);
+
+	// Hold frames back while the socket has more than maxSendQueue bytes that
+	// APRS-IS hasn't acknowledged, so that they wait in our queue, where the
+	// sites share it fairly, rather than in the kernel's. Zero is no limit.
+	void setMaxSendQueue(unsigned int maxSendQueue);
+
+	// When disabled the connection to APRS-IS is closed and the frames from
+	// the last warmTime seconds are kept, ready to be sent when enabled. The
+	// same is done while connecting. It is limited to 25 seconds, inside the
+	// duplicate window of APRS-IS.
+	void setEnabled(bool enabled, unsigned int warmTime = 0U);
+
+	unsigned int getQueueSize() const;
+	unsigned int getQueueUsed() const;
+
+	unsigned int getAllocatingFrames() const;
+
+	unsigned int getUDPFrames() const;
+	unsigned int getUDPFallbacks() const;
+
+	// The frames sent over the TCP session and the writes used to send them
+	unsigned int       getTCPFrames() const;
+	unsigned int       getTCPWrites() const;
+
+	// The frames held back by the linger, and their delays in microseconds
+	unsigned int       getLingeredFrames() const;
+	unsigned long long getLingerDelay() const;
+	unsigned long long getMaxLingerDelay() const;
+
+	// The frames held back by the pacing, and their delays in microseconds
+	unsigned int       getPacedFrames() const;
+	unsigned long long getPacingDelay() const;
+	unsigned long long getMaxPacingDelay() const;
+
+	unsigned int       getSlowFrames() const;
+
+	unsigned int       getSendQueueStalls() const;
+
 	void clock(unsigned int ms);
 
 private:
 	std::string                m_username;
 	std::string                m_password;
+	std::string                m_filter;
 	bool                       m_debug;
+	CAPRSTrace*                m_trace;
+	CAPRSFlightRecorder*       m_recorder;
 	CTCPSocket                 m_socket;
 	CRingBuffer<unsigned char> m_queue;
 	bool                       m_exit;
 	bool                       m_connected;
+	std::atomic<bool>          m_enabled;
+	std::atomic<unsigned long long> m_warmTime;
 	CTimer                     m_reconnectTimer;
 	unsigned int               m_tries;
 	ReadAPRSFrameCallback      m_aprsReadCallback;
+	CAPRSSites*                m_sites;
 	std::string                m_version;
+	unsigned int               m_allocating;
+	std::string                m_address;
+	CUDPSocket                 m_udpSocket;
+	sockaddr_storage           m_udpAddr;
+	unsigned int               m_udpAddrLen;
+	unsigned short             m_udpPort;
+	unsigned int               m_udpRate;
+	bool                       m_udpActive;
+	CTokenBucket               m_udpBucket;
+	CTimer                     m_udpRetryTimer;
+	std::string                m_login;
+	unsigned int               m_udpFrames;
+	unsigned int               m_udpFallbacks;
+	CTokenBucket               m_frameBucket;
+	CTokenBucket               m_byteBucket;
+	unsigned long long         m_pacedSince;
+	unsigned int               m_pacedFrames;
+	unsigned long long         m_pacingDelay;
+	unsigned long long         m_maxPacingDelay;
+	std::string                m_line;
+	unsigned long long         m_linger;
+	unsigned long long         m_lastWrite;
+	unsigned long long         m_lingerSince;
+	unsigned int               m_tcpFrames;
+	unsigned int               m_tcpWrites;
+	unsigned int               m_lingeredFrames;
+	unsigned long long         m_lingerDelay;
+	unsigned long long         m_maxLingerDelay;
+	unsigned long long         m_slowTime;
+	CTokenBucket               m_slowBucket;
+	unsigned int               m_slowFrames;
+	unsigned int               m_maxSendQueue;
+	bool                       m_sendQueueFull;
+	unsigned int               m_sendQueueStalls;
+	unsigned long long         m_lastSample;
+	unsigned int               m_retransmits;
 
 	bool connect();
+	bool login();
+	void countSent(const APRSFrameHeader& header, unsigned long long dequeued, unsigned long long sent);
+	void writeSlowFrame(const APRSFrameHeader& header, unsigned long long dequeued, unsigned long long sent);
+	bool openUDP();
+	bool sendUDP();
+	bool sendTCP(unsigned int& wait);
+	bool readLines(unsigned int wait);
+	void sampleTCP();
+	void getHeader(unsigned int offset, APRSFrameHeader& header) const;
+	bool isDebug() const;
+	bool isTraced(const unsigned char* p1, unsigned int length1, const unsigned char* p2, unsigned int length2);
+	void dump(const unsigned char* p1, unsigned int length1, const unsigned char* p2, unsigned int length2) const;
+	void trim();
 	void startReconnectionTimer();
 };
 
@@ -0,0 +1,90 @@
+/*
+ *   Copyright (C) 2026 by Jonathan Naylor G4KLX
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program; if not, write to the Free Software
+ *   Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+#include "Allocations.h"
+
+#if defined(COUNT_ALLOCATIONS)
+
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+static thread_local unsigned long long m_threadCount = 0ULL;
+
+static std::atomic<unsigned long long> m_total(0ULL);
+
+void* operator new(std::size_t size)
+{
+	m_threadCount++;
+	m_total.fetch_add(1ULL, std::memory_order_relaxed);
+
+	void* p = ::malloc(size > 0U ? size : 1U);
+	if (p == nullptr)
+		throw std::bad_alloc();
+
+	return p;
+}
+
+void* operator new[](std::size_t size)
+{
+	return operator new(size);
+}
+
+void operator delete(void* p) noexcept
+{
+	::free(p);
+}
+
+void operator delete[](void* p) noexcept
+{
+	::free(p);
+}
+
+bool CAllocations::isEnabled()
+{
+	return true;
+}
+
+unsigned long long CAllocations::getThreadCount()
+{
+	return m_threadCount;
+}
+
+unsigned long long CAllocations::getTotal()
+{
+	return m_total.load(std::memory_order_relaxed);
+}
+
+#else
+
+bool CAllocations::isEnabled()
+{
+	return false;
+}
+
+unsigned long long CAllocations::getThreadCount()
+{
+	return 0ULL;
+}
+
+unsigned long long CAllocations::getTotal()
+{
+	return 0ULL;
+}
+
+#endif
@@ -0,0 +1,35 @@
+/*
+ *   Copyright (C) 2026 by Jonathan Naylor G4KLX
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program; if not, write to the Free Software
+ *   Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+#if !defined(Allocations_H)
+#define	Allocations_H
+
+// Heap allocations are only counted when COUNT_ALLOCATIONS is defined, which
+// "make COUNT_ALLOCATIONS=1" does. It is used to check that the frame path
+// doesn't allocate.
+class CAllocations {
+public:
+	static bool isEnabled();
+
+	// The number of allocations made by the calling thread
+	static unsigned long long getThreadCount();
+
+	static unsigned long long getTotal();
+};
+
+#endif
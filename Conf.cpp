@@ -26,12 +26,23 @@
 
 const int BUFFER_SIZE = 500;
 
+#if defined(_WIN32) || defined(_WIN64)
+const char* DEFAULT_RECORDER_FILE = "APRSGateway-recorder.txt";
+#else
+const char* DEFAULT_RECORDER_FILE = "/var/log/mmdvm/APRSGateway-recorder.txt";
+#endif
+
 enum class SECTION {
   NONE,
   GENERAL,
   LOG,
   APRS_IS,
-  MQTT
+  MQTT,
+  CLUSTER,
+  SERVER,
+  INGEST,
+  KISS,
+  METRICS
 };
 
 CConf::CConf(const std::string& file) :
@@ -41,16 +52,68 @@ m_debug(false),
 m_daemon(false),
 m_logDisplayLevel(0U),
 m_logMQTTLevel(0U),
+m_logTraceSample(1U),
+m_logTraceRate(10U),
+m_logTraceCallsigns(),
+m_logFlightRecorder(4096U),
+m_logFlightRecorderFile(DEFAULT_RECORDER_FILE),
+m_logSlowFrameTime(0U),
 m_aprsServer(),
 m_aprsPort(0U),
 m_aprsPassword(),
+m_aprsFilter(),
+m_aprsUDPPort(0U),
+m_aprsUDPRate(20U),
+m_aprsMaxFrameRate(0U),
+m_aprsMaxByteRate(0U),
+m_aprsPacingBurst(250U),
+m_aprsLinger(0U),
+m_aprsMaxSendQueue(0U),
 m_mqttAddress("127.0.0.1"),
 m_mqttPort(1883U),
 m_mqttKeepalive(60U),
 m_mqttName("aprs-gateway"),
 m_mqttAuthEnabled(false),
 m_mqttUsername(),
-m_mqttPassword()
+m_mqttPassword(),
+m_mqttAPRSTopic("aprs"),
+m_mqttAPRSQoS(2U),
+m_mqttCommandTopic("command"),
+m_mqttStatsInterval(60U),
+m_mqttLogQoS(2U),
+m_mqttJSONQoS(2U),
+m_mqttInFlight(0U),
+m_mqttQueueLimit(0U),
+m_mqttDownlink(false),
+m_mqttBatchTopics(),
+m_mqttBatchFormat(0U),
+m_mqttBatchSize(1024U),
+m_mqttBatchLinger(100U),
+m_mqttReconnectDelay(1U),
+m_mqttReconnectMaxDelay(30U),
+m_mqttBufferSize(1000U),
+m_clusterEnabled(false),
+m_clusterGroup("aprsgateway"),
+m_clusterTopic("cluster"),
+m_clusterInstance(),
+m_clusterDedupeWindow(30U),
+m_clusterElection(false),
+m_clusterLeaseTopic("lease"),
+m_clusterFailoverTime(10U),
+m_serverEnabled(false),
+m_serverAddress("127.0.0.1"),
+m_serverPort(14580U),
+m_serverMaxClients(100U),
+m_serverBufferSize(65536U),
+m_ingestUnixPath(),
+m_ingestUDPAddress("127.0.0.1"),
+m_ingestUDPPort(0U),
+m_kissEnabled(false),
+m_kissAddress("127.0.0.1"),
+m_kissPort(8001U),
+m_metricsEnabled(false),
+m_metricsAddress("127.0.0.1"),
+m_metricsPort(9108U)
 {
 }
 
@@ -82,6 +145,16 @@ bool CConf::read()
 				section = SECTION::APRS_IS;
 			else if (::strncmp(buffer, "[MQTT]", 6U) == 0)
 				section = SECTION::MQTT;
+			else if (::strncmp(buffer, "[Cluster]", 9U) == 0)
+				section = SECTION::CLUSTER;
+			else if (::strncmp(buffer, "[Server]", 8U) == 0)
+				section = SECTION::SERVER;
+			else if (::strncmp(buffer, "[Ingest]", 8U) == 0)
+				section = SECTION::INGEST;
+			else if (::strncmp(buffer, "[KISS]", 6U) == 0)
+				section = SECTION::KISS;
+			else if (::strncmp(buffer, "[Metrics]", 9U) == 0)
+				section = SECTION::METRICS;
 			else
 				section = SECTION::NONE;
 
@@ -128,6 +201,18 @@ bool CConf::read()
 				m_logMQTTLevel = (unsigned int)::atoi(value);
 			else if (::strcmp(key, "DisplayLevel") == 0)
 				m_logDisplayLevel = (unsigned int)::atoi(value);
+			else if (::strcmp(key, "TraceSample") == 0)
+				m_logTraceSample = (unsigned int)::atoi(value);
+			else if (::strcmp(key, "TraceRate") == 0)
+				m_logTraceRate = (unsigned int)::atoi(value);
+			else if (::strcmp(key, "TraceCallsigns") == 0)
+				m_logTraceCallsigns = value;
+			else if (::strcmp(key, "FlightRecorder") == 0)
+				m_logFlightRecorder = (unsigned int)::atoi(value);
+			else if (::strcmp(key, "FlightRecorderFile") == 0)
+				m_logFlightRecorderFile = value;
+			else if (::strcmp(key, "SlowFrameTime") == 0)
+				m_logSlowFrameTime = (unsigned int)::atoi(value);
 		} else if (section == SECTION::APRS_IS) {
 			if (::strcmp(key, "Server") == 0)
 				m_aprsServer = value;
@@ -135,6 +220,22 @@ bool CConf::read()
 				m_aprsPort = (unsigned short)::atoi(value);
 			else if (::strcmp(key, "Password") == 0)
 				m_aprsPassword = value;
+			else if (::strcmp(key, "Filter") == 0)
+				m_aprsFilter = value;
+			else if (::strcmp(key, "UDPPort") == 0)
+				m_aprsUDPPort = (unsigned short)::atoi(value);
+			else if (::strcmp(key, "UDPRate") == 0)
+				m_aprsUDPRate = (unsigned int)::atoi(value);
+			else if (::strcmp(key, "MaxFrameRate") == 0)
+				m_aprsMaxFrameRate = (unsigned int)::atoi(value);
+			else if (::strcmp(key, "MaxByteRate") == 0)
+				m_aprsMaxByteRate = (unsigned int)::atoi(value);
+			else if (::strcmp(key, "PacingBurst") == 0)
+				m_aprsPacingBurst = (unsigned int)::atoi(value);
+			else if (::strcmp(key, "Linger") == 0)
+				m_aprsLinger = (unsigned int)::atoi(value);
+			else if (::strcmp(key, "MaxSendQueue") == 0)
+				m_aprsMaxSendQueue = (unsigned int)::atoi(value);
 		} else if (section == SECTION::MQTT) {
 			if (::strcmp(key, "Address") == 0)
 				m_mqttAddress = value;
@@ -150,6 +251,91 @@ bool CConf::read()
 				m_mqttUsername = value;
 			else if (::strcmp(key, "Password") == 0)
 				m_mqttPassword = value;
+			else if (::strcmp(key, "APRSTopic") == 0)
+				m_mqttAPRSTopic = value;
+			else if (::strcmp(key, "APRSQoS") == 0)
+				m_mqttAPRSQoS = (unsigned int)::atoi(value);
+			else if (::strcmp(key, "CommandTopic") == 0)
+				m_mqttCommandTopic = value;
+			else if (::strcmp(key, "StatsInterval") == 0)
+				m_mqttStatsInterval = (unsigned int)::atoi(value);
+			else if (::strcmp(key, "LogQoS") == 0)
+				m_mqttLogQoS = (unsigned int)::atoi(value);
+			else if (::strcmp(key, "JSONQoS") == 0)
+				m_mqttJSONQoS = (unsigned int)::atoi(value);
+			else if (::strcmp(key, "InFlight") == 0)
+				m_mqttInFlight = (unsigned int)::atoi(value);
+			else if (::strcmp(key, "QueueLimit") == 0)
+				m_mqttQueueLimit = (unsigned int)::atoi(value);
+			else if (::strcmp(key, "Downlink") == 0)
+				m_mqttDownlink = ::atoi(value) == 1;
+			else if (::strcmp(key, "BatchTopics") == 0) {
+				char* p = ::strtok(value, ", ");
+				while (p != nullptr) {
+					m_mqttBatchTopics.push_back(std::string(p));
+					p = ::strtok(nullptr, ", ");
+				}
+			} else if (::strcmp(key, "BatchFormat") == 0)
+				m_mqttBatchFormat = (unsigned int)::atoi(value);
+			else if (::strcmp(key, "BatchSize") == 0)
+				m_mqttBatchSize = (unsigned int)::atoi(value);
+			else if (::strcmp(key, "BatchLinger") == 0)
+				m_mqttBatchLinger = (unsigned int)::atoi(value);
+			else if (::strcmp(key, "ReconnectDelay") == 0)
+				m_mqttReconnectDelay = (unsigned int)::atoi(value);
+			else if (::strcmp(key, "ReconnectMaxDelay") == 0)
+				m_mqttReconnectMaxDelay = (unsigned int)::atoi(value);
+			else if (::strcmp(key, "BufferSize") == 0)
+				m_mqttBufferSize = (unsigned int)::atoi(value);
+		} else if (section == SECTION::CLUSTER) {
+			if (::strcmp(key, "Enable") == 0)
+				m_clusterEnabled = ::atoi(value) == 1;
+			else if (::strcmp(key, "Group") == 0)
+				m_clusterGroup = value;
+			else if (::strcmp(key, "Topic") == 0)
+				m_clusterTopic = value;
+			else if (::strcmp(key, "Instance") == 0)
+				m_clusterInstance = value;
+			else if (::strcmp(key, "DedupeWindow") == 0)
+				m_clusterDedupeWindow = (unsigned int)::atoi(value);
+			else if (::strcmp(key, "Election") == 0)
+				m_clusterElection = ::atoi(value) == 1;
+			else if (::strcmp(key, "LeaseTopic") == 0)
+				m_clusterLeaseTopic = value;
+			else if (::strcmp(key, "FailoverTime") == 0)
+				m_clusterFailoverTime = (unsigned int)::atoi(value);
+		} else if (section == SECTION::SERVER) {
+			if (::strcmp(key, "Enable") == 0)
+				m_serverEnabled = ::atoi(value) == 1;
+			else if (::strcmp(key, "Address") == 0)
+				m_serverAddress = value;
+			else if (::strcmp(key, "Port") == 0)
+				m_serverPort = (unsigned short)::atoi(value);
+			else if (::strcmp(key, "MaxClients") == 0)
+				m_serverMaxClients = (unsigned int)::atoi(value);
+			else if (::strcmp(key, "BufferSize") == 0)
+				m_serverBufferSize = (unsigned int)::atoi(value);
+		} else if (section == SECTION::INGEST) {
+			if (::strcmp(key, "UnixPath") == 0)
+				m_ingestUnixPath = value;
+			else if (::strcmp(key, "UDPAddress") == 0)
+				m_ingestUDPAddress = value;
+			else if (::strcmp(key, "UDPPort") == 0)
+				m_ingestUDPPort = (unsigned short)::atoi(value);
+		} else if (section == SECTION::KISS) {
+			if (::strcmp(key, "Enable") == 0)
+				m_kissEnabled = ::atoi(value) == 1;
+			else if (::strcmp(key, "Address") == 0)
+				m_kissAddress = value;
+			else if (::strcmp(key, "Port") == 0)
+				m_kissPort = (unsigned short)::atoi(value);
+		} else if (section == SECTION::METRICS) {
+			if (::strcmp(key, "Enable") == 0)
+				m_metricsEnabled = ::atoi(value) == 1;
+			else if (::strcmp(key, "Address") == 0)
+				m_metricsAddress = value;
+			else if (::strcmp(key, "Port") == 0)
+				m_metricsPort = (unsigned short)::atoi(value);
 		}
 	}
 
@@ -188,6 +374,46 @@ std::string CConf::getAPRSPassword() const
 	return m_aprsPassword;
 }
 
+std::string CConf::getAPRSFilter() const
+{
+	return m_aprsFilter;
+}
+
+unsigned short CConf::getAPRSUDPPort() const
+{
+	return m_aprsUDPPort;
+}
+
+unsigned int CConf::getAPRSUDPRate() const
+{
+	return m_aprsUDPRate;
+}
+
+unsigned int CConf::getAPRSMaxFrameRate() const
+{
+	return m_aprsMaxFrameRate;
+}
+
+unsigned int CConf::getAPRSMaxByteRate() const
+{
+	return m_aprsMaxByteRate;
+}
+
+unsigned int CConf::getAPRSPacingBurst() const
+{
+	return m_aprsPacingBurst;
+}
+
+unsigned int CConf::getAPRSLinger() const
+{
+	return m_aprsLinger;
+}
+
+unsigned int CConf::getAPRSMaxSendQueue() const
+{
+	return m_aprsMaxSendQueue;
+}
+
 unsigned int CConf::getLogDisplayLevel() const
 {
 	return m_logDisplayLevel;
@@ -198,6 +424,36 @@ unsigned int CConf::getLogMQTTLevel() const
 	return m_logMQTTLevel;
 }
 
+unsigned int CConf::getLogTraceSample() const
+{
+	return m_logTraceSample;
+}
+
+unsigned int CConf::getLogTraceRate() const
+{
+	return m_logTraceRate;
+}
+
+std::string CConf::getLogTraceCallsigns() const
+{
+	return m_logTraceCallsigns;
+}
+
+unsigned int CConf::getLogFlightRecorder() const
+{
+	return m_logFlightRecorder;
+}
+
+std::string CConf::getLogFlightRecorderFile() const
+{
+	return m_logFlightRecorderFile;
+}
+
+unsigned int CConf::getLogSlowFrameTime() const
+{
+	return m_logSlowFrameTime;
+}
+
 std::string CConf::getMQTTAddress() const
 {
 	return m_mqttAddress;
@@ -232,3 +488,193 @@ std::string CConf::getMQTTPassword() const
 {
 	return m_mqttPassword;
 }
+
+std::string CConf::getMQTTAPRSTopic() const
+{
+	return m_mqttAPRSTopic;
+}
+
+unsigned int CConf::getMQTTAPRSQoS() const
+{
+	return m_mqttAPRSQoS;
+}
+
+std::string CConf::getMQTTCommandTopic() const
+{
+	return m_mqttCommandTopic;
+}
+
+unsigned int CConf::getMQTTStatsInterval() const
+{
+	return m_mqttStatsInterval;
+}
+
+unsigned int CConf::getMQTTLogQoS() const
+{
+	return m_mqttLogQoS;
+}
+
+unsigned int CConf::getMQTTJSONQoS() const
+{
+	return m_mqttJSONQoS;
+}
+
+unsigned int CConf::getMQTTInFlight() const
+{
+	return m_mqttInFlight;
+}
+
+unsigned int CConf::getMQTTQueueLimit() const
+{
+	return m_mqttQueueLimit;
+}
+
+bool CConf::getMQTTDownlink() const
+{
+	return m_mqttDownlink;
+}
+
+std::vector<std::string> CConf::getMQTTBatchTopics() const
+{
+	return m_mqttBatchTopics;
+}
+
+unsigned int CConf::getMQTTBatchFormat() const
+{
+	return m_mqttBatchFormat;
+}
+
+unsigned int CConf::getMQTTBatchSize() const
+{
+	return m_mqttBatchSize;
+}
+
+unsigned int CConf::getMQTTBatchLinger() const
+{
+	return m_mqttBatchLinger;
+}
+
+unsigned int CConf::getMQTTReconnectDelay() const
+{
+	return m_mqttReconnectDelay;
+}
+
+unsigned int CConf::getMQTTReconnectMaxDelay() const
+{
+	return m_mqttReconnectMaxDelay;
+}
+
+unsigned int CConf::getMQTTBufferSize() const
+{
+	return m_mqttBufferSize;
+}
+
+bool CConf::getClusterEnabled() const
+{
+	return m_clusterEnabled;
+}
+
+std::string CConf::getClusterGroup() const
+{
+	return m_clusterGroup;
+}
+
+std::string CConf::getClusterTopic() const
+{
+	return m_clusterTopic;
+}
+
+std::string CConf::getClusterInstance() const
+{
+	return m_clusterInstance;
+}
+
+unsigned int CConf::getClusterDedupeWindow() const
+{
+	return m_clusterDedupeWindow;
+}
+
+bool CConf::getClusterElection() const
+{
+	return m_clusterElection;
+}
+
+std::string CConf::getClusterLeaseTopic() const
+{
+	return m_clusterLeaseTopic;
+}
+
+unsigned int CConf::getClusterFailoverTime() const
+{
+	return m_clusterFailoverTime;
+}
+
+bool CConf::getServerEnabled() const
+{
+	return m_serverEnabled;
+}
+
+std::string CConf::getServerAddress() const
+{
+	return m_serverAddress;
+}
+
+unsigned short CConf::getServerPort() const
+{
+	return m_serverPort;
+}
+
+unsigned int CConf::getServerMaxClients() const
+{
+	return m_serverMaxClients;
+}
+
+unsigned int CConf::getServerBufferSize() const
+{
+	return m_serverBufferSize;
+}
+
+std::string CConf::getIngestUnixPath() const
+{
+	return m_ingestUnixPath;
+}
+
+std::string CConf::getIngestUDPAddress() const
+{
+	return m_ingestUDPAddress;
+}
+
+unsigned short CConf::getIngestUDPPort() const
+{
+	return m_ingestUDPPort;
+}
+
+bool CConf::getKISSEnabled() const
+{
+	return m_kissEnabled;
+}
+
+std::string CConf::getKISSAddress() const
+{
+	return m_kissAddress;
+}
+
+unsigned short CConf::getKISSPort() const
+{
+	return m_kissPort;
+}
+
+bool CConf::getMetricsEnabled() const
+{
+	return m_metricsEnabled;
+}
+
+std::string CConf::getMetricsAddress() const
+{
+	return m_metricsAddress;
+}
+
+unsigned short CConf::getMetricsPort() const
+{
+	return m_metricsPort;
+}
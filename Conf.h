@@ -20,6 +20,7 @@
 #define	CONF_H
 
 #include <string>
+#include <vector>
 
 class CConf
 {
@@ -38,10 +39,24 @@ public:
   std::string  getAPRSServer() const;
   unsigned short getAPRSPort() const;
   std::string  getAPRSPassword() const;
+  std::string  getAPRSFilter() const;
+  unsigned short getAPRSUDPPort() const;
+  unsigned int getAPRSUDPRate() const;
+  unsigned int getAPRSMaxFrameRate() const;
+  unsigned int getAPRSMaxByteRate() const;
+  unsigned int getAPRSPacingBurst() const;
+  unsigned int getAPRSLinger() const;
+  unsigned int getAPRSMaxSendQueue() const;
 
   // The Log section
   unsigned int getLogDisplayLevel() const;
   unsigned int getLogMQTTLevel() const;
+  unsigned int getLogTraceSample() const;
+  unsigned int getLogTraceRate() const;
+  std::string  getLogTraceCallsigns() const;
+  unsigned int getLogFlightRecorder() const;
+  std::string  getLogFlightRecorderFile() const;
+  unsigned int getLogSlowFrameTime() const;
 
   // The MQTT section
   std::string  getMQTTAddress() const;
@@ -51,6 +66,54 @@ public:
   bool         getMQTTAuthEnabled() const;
   std::string  getMQTTUsername() const;
   std::string  getMQTTPassword() const;
+  std::string  getMQTTAPRSTopic() const;
+  unsigned int getMQTTAPRSQoS() const;
+  std::string  getMQTTCommandTopic() const;
+  unsigned int getMQTTStatsInterval() const;
+  unsigned int getMQTTLogQoS() const;
+  unsigned int getMQTTJSONQoS() const;
+  unsigned int getMQTTInFlight() const;
+  unsigned int getMQTTQueueLimit() const;
+  bool         getMQTTDownlink() const;
+  std::vector<std::string> getMQTTBatchTopics() const;
+  unsigned int getMQTTBatchFormat() const;
+  unsigned int getMQTTBatchSize() const;
+  unsigned int getMQTTBatchLinger() const;
+  unsigned int getMQTTReconnectDelay() const;
+  unsigned int getMQTTReconnectMaxDelay() const;
+  unsigned int getMQTTBufferSize() const;
+
+  // The Cluster section
+  bool         getClusterEnabled() const;
+  std::string  getClusterGroup() const;
+  std::string  getClusterTopic() const;
+  std::string  getClusterInstance() const;
+  unsigned int getClusterDedupeWindow() const;
+  bool         getClusterElection() const;
+  std::string  getClusterLeaseTopic() const;
+  unsigned int getClusterFailoverTime() const;
+
+  // The Server section
+  bool         getServerEnabled() const;
+  std::string  getServerAddress() const;
+  unsigned short getServerPort() const;
+  unsigned int getServerMaxClients() const;
+  unsigned int getServerBufferSize() const;
+
+  // The Ingest section
+  std::string  getIngestUnixPath() const;
+  std::string  getIngestUDPAddress() const;
+  unsigned short getIngestUDPPort() const;
+
+  // The KISS section
+  bool         getKISSEnabled() const;
+  std::string  getKISSAddress() const;
+  unsigned short getKISSPort() const;
+
+  // The Metrics section
+  bool         getMetricsEnabled() const;
+  std::string  getMetricsAddress() const;
+  unsigned short getMetricsPort() const;
 
 private:
   std::string  m_file;
@@ -60,10 +123,24 @@ private:
 
   unsigned int m_logDisplayLevel;
   unsigned int m_logMQTTLevel;
+  unsigned int m_logTraceSample;
+  unsigned int m_logTraceRate;
+  std::string  m_logTraceCallsigns;
+  unsigned int m_logFlightRecorder;
+  std::string  m_logFlightRecorderFile;
+  unsigned int m_logSlowFrameTime;
 
   std::string  m_aprsServer;
   unsigned short m_aprsPort;
   std::string  m_aprsPassword;
+  std::string  m_aprsFilter;
+  unsigned short m_aprsUDPPort;
+  unsigned int m_aprsUDPRate;
+  unsigned int m_aprsMaxFrameRate;
+  unsigned int m_aprsMaxByteRate;
+  unsigned int m_aprsPacingBurst;
+  unsigned int m_aprsLinger;
+  unsigned int m_aprsMaxSendQueue;
 
   std::string  m_mqttAddress;
   unsigned short m_mqttPort;
@@ -72,6 +149,49 @@ private:
   bool         m_mqttAuthEnabled;
   std::string  m_mqttUsername;
   std::string  m_mqttPassword;
+  std::string  m_mqttAPRSTopic;
+  unsigned int m_mqttAPRSQoS;
+  std::string  m_mqttCommandTopic;
+  unsigned int m_mqttStatsInterval;
+  unsigned int m_mqttLogQoS;
+  unsigned int m_mqttJSONQoS;
+  unsigned int m_mqttInFlight;
+  unsigned int m_mqttQueueLimit;
+  bool         m_mqttDownlink;
+  std::vector<std::string> m_mqttBatchTopics;
+  unsigned int m_mqttBatchFormat;
+  unsigned int m_mqttBatchSize;
+  unsigned int m_mqttBatchLinger;
+  unsigned int m_mqttReconnectDelay;
+  unsigned int m_mqttReconnectMaxDelay;
+  unsigned int m_mqttBufferSize;
+
+  bool         m_clusterEnabled;
+  std::string  m_clusterGroup;
+  std::string  m_clusterTopic;
+  std::string  m_clusterInstance;
+  unsigned int m_clusterDedupeWindow;
+  bool         m_clusterElection;
+  std::string  m_clusterLeaseTopic;
+  unsigned int m_clusterFailoverTime;
+
+  bool         m_serverEnabled;
+  std::string  m_serverAddress;
+  unsigned short m_serverPort;
+  unsigned int m_serverMaxClients;
+  unsigned int m_serverBufferSize;
+
+  std::string  m_ingestUnixPath;
+  std::string  m_ingestUDPAddress;
+  unsigned short m_ingestUDPPort;
+
+  bool         m_kissEnabled;
+  std::string  m_kissAddress;
+  unsigned short m_kissPort;
+
+  bool         m_metricsEnabled;
+  std::string  m_metricsAddress;
+  unsigned short m_metricsPort;
 };
 
 #endif
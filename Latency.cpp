@@ -0,0 +1,160 @@
+/*
+ *   Copyright (C) 2026 by Jonathan Naylor G4KLX
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program; if not, write to the Free Software
+ *   Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+#include "Latency.h"
+
+#include <atomic>
+#include <cassert>
+
+// Each power of two is split into 128 buckets, so a bucket is never wider than
+// 1/128 of its value, and below 256 each value has its own
+const unsigned int SUB_BUCKET_BITS  = 8U;
+const unsigned int SUB_BUCKET_COUNT = 1U << SUB_BUCKET_BITS;
+const unsigned int SUB_BUCKET_HALF  = SUB_BUCKET_COUNT / 2U;
+
+// Values below 2^40 microseconds, about 12 days, larger ones share the last bucket
+const unsigned int MAX_VALUE_BITS = 40U;
+const unsigned int BUCKET_COUNT   = (MAX_VALUE_BITS - SUB_BUCKET_BITS + 2U) * SUB_BUCKET_HALF;
+
+static const char* NAMES[LATENCY_COUNT] = {
+	"ingress", "queue", "send", "total"
+};
+
+struct CStageHistogram {
+	std::atomic<unsigned long long> m_buckets[BUCKET_COUNT];
+	std::atomic<unsigned long long> m_count;
+	std::atomic<unsigned long long> m_sum;
+	std::atomic<unsigned long long> m_max;
+};
+
+static CStageHistogram m_stages[LATENCY_COUNT];
+
+static unsigned int getIndex(unsigned long long value)
+{
+	if (value < SUB_BUCKET_COUNT)
+		return (unsigned int)value;
+
+	// Find the top bit by halves, which works with every compiler
+	unsigned int msb = 0U;
+	for (unsigned int bits = 32U; bits > 0U; bits /= 2U) {
+		if ((value >> (msb + bits)) != 0ULL)
+			msb += bits;
+	}
+
+	unsigned int shift = msb - (SUB_BUCKET_BITS - 1U);
+
+	unsigned int index = shift * SUB_BUCKET_HALF + (unsigned int)(value >> shift);
+
+	return (index < BUCKET_COUNT) ? index : (BUCKET_COUNT - 1U);
+}
+
+// The largest value that falls in the bucket
+static unsigned long long getValue(unsigned int index)
+{
+	if (index < SUB_BUCKET_COUNT)
+		return index;
+
+	unsigned int shift = (index / SUB_BUCKET_HALF) - 1U;
+	unsigned long long sub = index - shift * SUB_BUCKET_HALF;
+
+	return ((sub + 1ULL) << shift) - 1ULL;
+}
+
+// Only one thread records a stage at a time, so a plain store will do
+static void add(std::atomic<unsigned long long>& value, unsigned long long n)
+{
+	value.store(value.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+}
+
+void CLatency::record(LATENCY stage, unsigned long long value)
+{
+	assert((unsigned int)stage < LATENCY_COUNT);
+
+	CStageHistogram& histogram = m_stages[(unsigned int)stage];
+
+	add(histogram.m_buckets[getIndex(value)], 1ULL);
+	add(histogram.m_count, 1ULL);
+	add(histogram.m_sum, value);
+
+	if (value > histogram.m_max.load(std::memory_order_relaxed))
+		histogram.m_max.store(value, std::memory_order_relaxed);
+}
+
+unsigned long long CLatency::getCount(LATENCY stage)
+{
+	assert((unsigned int)stage < LATENCY_COUNT);
+
+	return m_stages[(unsigned int)stage].m_count.load(std::memory_order_relaxed);
+}
+
+unsigned long long CLatency::getSum(LATENCY stage)
+{
+	assert((unsigned int)stage < LATENCY_COUNT);
+
+	return m_stages[(unsigned int)stage].m_sum.load(std::memory_order_relaxed);
+}
+
+unsigned long long CLatency::getMax(LATENCY stage)
+{
+	assert((unsigned int)stage < LATENCY_COUNT);
+
+	return m_stages[(unsigned int)stage].m_max.load(std::memory_order_relaxed);
+}
+
+unsigned long long CLatency::getPercentile(LATENCY stage, double percentile)
+{
+	assert((unsigned int)stage < LATENCY_COUNT);
+	assert(percentile >= 0.0 && percentile <= 100.0);
+
+	const CStageHistogram& histogram = m_stages[(unsigned int)stage];
+
+	// The buckets may move on while being read, so count them rather than trust m_count
+	unsigned long long total = 0ULL;
+	for (unsigned int i = 0U; i < BUCKET_COUNT; i++)
+		total += histogram.m_buckets[i].load(std::memory_order_relaxed);
+
+	if (total == 0ULL)
+		return 0ULL;
+
+	unsigned long long target = (unsigned long long)((percentile / 100.0) * double(total) + 0.5);
+	if (target == 0ULL)
+		target = 1ULL;
+
+	unsigned long long max = histogram.m_max.load(std::memory_order_relaxed);
+
+	unsigned long long count = 0ULL;
+	for (unsigned int i = 0U; i < BUCKET_COUNT; i++) {
+		count += histogram.m_buckets[i].load(std::memory_order_relaxed);
+		if (count >= target) {
+			if (i == (BUCKET_COUNT - 1U))
+				return max;
+
+			unsigned long long value = getValue(i);
+			return (value < max) ? value : max;
+		}
+	}
+
+	return max;
+}
+
+const char* CLatency::getName(LATENCY stage)
+{
+	assert((unsigned int)stage < LATENCY_COUNT);
+
+	return NAMES[(unsigned int)stage];
+}
@@ -0,0 +1,51 @@
+/*
+ *   Copyright (C) 2026 by Jonathan Naylor G4KLX
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program; if not, write to the Free Software
+ *   Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+#if !defined(Latency_H)
+#define	Latency_H
+
+// The stages of a frame's journey through the gateway
+enum class LATENCY : unsigned int {
+	INGRESS,		// From arrival to being queued, validation and the like
+	QUEUE,			// Waiting in the queue to be picked for sending
+	SEND,			// Handing the frame to the socket
+	TOTAL			// From arrival to the socket
+};
+
+const unsigned int LATENCY_COUNT = 4U;
+
+// Histograms of the stage times with log-linear buckets, in the style of
+// HdrHistogram, accurate to within 1% from a microsecond up to days. This
+// gives percentiles that the fixed buckets of CMetrics cannot. Each stage is
+// only recorded by one thread at a time, so no locks are needed.
+class CLatency {
+public:
+	// The value is in microseconds
+	static void record(LATENCY stage, unsigned long long value);
+
+	static unsigned long long getCount(LATENCY stage);
+	static unsigned long long getSum(LATENCY stage);
+	static unsigned long long getMax(LATENCY stage);
+
+	// The value below which the percentage of the frames fall, such as 99.9
+	static unsigned long long getPercentile(LATENCY stage, double percentile);
+
+	static const char* getName(LATENCY stage);
+};
+
+#endif
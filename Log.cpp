@@ -1,5 +1,5 @@
 /*
- *   Copyright (C) 2015,2016,2020,2022,2023,2025 by Jonathan Naylor G4KLX
+ *   Copyright (C) 2015,2016,2020,2022,2023,2025,2026 by Jonathan Naylor G4KLX
  *
  *   This program is free software; you can redistribute it and/or modify
  *   it under the terms of the GNU General Public License as published by
@@ -18,6 +18,11 @@
 
 #include "Log.h"
 #include "MQTTConnection.h"
+#include "RingBuffer.h"
+#include "Timestamp.h"
+#include "Profile.h"
+#include "Thread.h"
+#include "Mutex.h"
 
 #if defined(_WIN32) || defined(_WIN64)
 #include <Windows.h>
@@ -26,6 +31,9 @@
 #include <unistd.h>
 #endif
 
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
 #include <cstdio>
 #include <cstdlib>
 #include <cstdarg>
@@ -41,61 +49,406 @@ static unsigned int m_displayLevel = 2U;
 
 static char LEVELS[] = " DMIWEF";
 
+const unsigned int LOG_TEXT_LENGTH = 500U;
+
+// Each thread that logs gets its own queue, up to a limit of threads at once.
+// The queue goes back to be used again when its thread exits.
+const unsigned int LOG_QUEUE_SIZE = 65536U;
+const unsigned int MAX_LOG_QUEUES = 32U;
+
+// The longest the logger thread sleeps without being woken, in milliseconds
+const unsigned int LOG_IDLE_TIME = 1000U;
+
+// Stored in a queue in front of the text of each record
+struct LogRecord {
+	unsigned long long m_time;
+	unsigned int       m_level;
+	unsigned int       m_length;
+};
+
+// Takes the records from the queues, oldest first, and writes them out
+class CLogThread : public CThread {
+public:
+	CLogThread();
+	virtual ~CLogThread();
+
+	virtual void entry();
+
+	void stop();
+
+	// Writes out every queued record, returns false if there were none
+	bool drain();
+
+private:
+	std::atomic<bool> m_exit;
+	unsigned int      m_reported;
+};
+
+struct CLogQueue {
+	std::atomic<CRingBuffer<unsigned char>*> m_queue;
+	std::atomic<bool>                        m_used;
+};
+
+static CLogQueue m_queues[MAX_LOG_QUEUES];
+static std::atomic<unsigned int> m_queueCount(0U);
+static CMutex m_queueMutex;
+static std::atomic<bool> m_noQueueReported(false);
+
+// Gives the queue back when its thread exits. Any records still in it are
+// written out as usual, and the next thread to take the queue adds to them.
+struct CQueueOwner {
+	CLogQueue* m_slot;
+	bool       m_noQueue;
+
+	~CQueueOwner()
+	{
+		if (m_slot != nullptr)
+			m_slot->m_used.store(false, std::memory_order_release);
+	}
+};
+
+static thread_local CQueueOwner m_owner = {nullptr, false};
+
+// The logger thread waits on these when there is nothing to write
+static std::atomic<bool> m_sleeping(false);
+static CMutex m_wakeMutex;
+static std::condition_variable_any m_wake;
+
+static std::atomic<bool> m_async(false);
+static std::atomic<unsigned int> m_dropped(0U);
+
+static CLogThread* m_thread = nullptr;
+
+static void output(unsigned int level, unsigned long long time, const char* text, unsigned int length)
+{
+	char buffer[LOG_BLOCK_LENGTH + TIMESTAMP_LENGTH + 5U];
+	buffer[0U] = LEVELS[level];
+	buffer[1U] = ':';
+	buffer[2U] = ' ';
+
+	unsigned int prefix = 3U + CTimestamp::format(time, ' ', buffer + 3U);
+	buffer[prefix++] = ' ';
+
+	::memcpy(buffer + prefix, text, length);
+	buffer[prefix + length] = '\0';
+
+	if (m_mqtt != nullptr && level >= m_mqttLevel && m_mqttLevel != 0U)
+		m_mqtt->publish("log", buffer);
+
+	if (level >= m_displayLevel && m_displayLevel != 0U)
+		::fprintf(stdout, "%s\n", buffer);
+}
+
+// Finds a free queue for the calling thread, or makes one
+static CRingBuffer<unsigned char>* getQueue()
+{
+	if (m_owner.m_slot != nullptr)
+		return m_owner.m_slot->m_queue.load(std::memory_order_relaxed);
+
+	if (m_owner.m_noQueue)
+		return nullptr;
+
+	m_queueMutex.lock();
+
+	unsigned int count = m_queueCount.load(std::memory_order_relaxed);
+
+	CLogQueue* slot = nullptr;
+	for (unsigned int i = 0U; i < count && slot == nullptr; i++) {
+		if (!m_queues[i].m_used.load(std::memory_order_acquire))
+			slot = &m_queues[i];
+	}
+
+	if (slot == nullptr && count < MAX_LOG_QUEUES)
+		slot = &m_queues[count];
+
+	if (slot != nullptr) {
+		if (slot->m_queue.load(std::memory_order_relaxed) == nullptr)
+			slot->m_queue.store(new CRingBuffer<unsigned char>(LOG_QUEUE_SIZE, "Log Queue"), std::memory_order_release);
+
+		slot->m_used.store(true, std::memory_order_release);
+		m_owner.m_slot = slot;
+
+		if (slot == &m_queues[count])
+			m_queueCount.store(count + 1U, std::memory_order_release);
+	} else {
+		// Too many threads at once, this one logs directly
+		m_owner.m_noQueue = true;
+	}
+
+	m_queueMutex.unlock();
+
+	if (slot == nullptr && !m_noQueueReported.exchange(true))
+		::fprintf(stderr, "More than %u threads are logging, the others log directly\n", MAX_LOG_QUEUES);
+
+	return (slot != nullptr) ? slot->m_queue.load(std::memory_order_relaxed) : nullptr;
+}
+
+// Gives up the queue of the calling thread, and frees those with no thread.
+// Only called once the logger thread has gone.
+static void freeQueues()
+{
+	if (m_owner.m_slot != nullptr) {
+		m_owner.m_slot->m_used.store(false, std::memory_order_release);
+		m_owner.m_slot = nullptr;
+	}
+
+	m_queueMutex.lock();
+
+	// A queue that a live thread still holds stays, it is used again after a restart
+	unsigned int count = m_queueCount.load(std::memory_order_relaxed);
+	for (unsigned int i = 0U; i < count; i++) {
+		if (!m_queues[i].m_used.load(std::memory_order_acquire))
+			delete m_queues[i].m_queue.exchange(nullptr);
+	}
+
+	m_queueMutex.unlock();
+}
+
+static bool hasRecords()
+{
+	unsigned int count = m_queueCount.load(std::memory_order_acquire);
+	for (unsigned int i = 0U; i < count; i++) {
+		CRingBuffer<unsigned char>* queue = m_queues[i].m_queue.load(std::memory_order_acquire);
+		if (queue != nullptr && queue->hasData())
+			return true;
+	}
+
+	return false;
+}
+
+// Called after queueing a record, only takes the lock if the logger thread is asleep
+static void wakeLogger()
+{
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+	if (!m_sleeping.load())
+		return;
+
+	m_wakeMutex.lock();
+	m_wake.notify_one();
+	m_wakeMutex.unlock();
+}
+
+CLogThread::CLogThread() :
+CThread(),
+m_exit(false),
+m_reported(0U)
+{
+}
+
+CLogThread::~CLogThread()
+{
+}
+
+void CLogThread::entry()
+{
+	PROFILE_THREAD("log");
+
+	while (!m_exit) {
+		if (drain())
+			continue;
+
+		// Check again once the writers can see that we're asleep, so a record
+		// queued in between isn't left until the timeout
+		m_wakeMutex.lock();
+		m_sleeping.store(true);
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+
+		if (!m_exit && !hasRecords())
+			m_wake.wait_for(m_wakeMutex, std::chrono::milliseconds(LOG_IDLE_TIME));
+
+		m_sleeping.store(false);
+		m_wakeMutex.unlock();
+	}
+
+	drain();
+}
+
+void CLogThread::stop()
+{
+	m_exit = true;
+
+	m_wakeMutex.lock();
+	m_wake.notify_one();
+	m_wakeMutex.unlock();
+
+	wait();
+}
+
+bool CLogThread::drain()
+{
+	bool written = false;
+
+	for (;;) {
+		// Pick the oldest record from all of the queues
+		unsigned int count = m_queueCount.load(std::memory_order_acquire);
+
+		CRingBuffer<unsigned char>* oldest = nullptr;
+		LogRecord record;
+		record.m_time = 0ULL;
+
+		for (unsigned int i = 0U; i < count; i++) {
+			CRingBuffer<unsigned char>* queue = m_queues[i].m_queue.load(std::memory_order_acquire);
+			if (queue == nullptr || queue->isEmpty())
+				continue;
+
+			LogRecord header;
+			queue->peek((unsigned char*)&header, sizeof(LogRecord));
+
+			if (oldest == nullptr || header.m_time < record.m_time) {
+				oldest = queue;
+				record = header;
+			}
+		}
+
+		if (oldest == nullptr)
+			break;
+
+		char text[LOG_BLOCK_LENGTH];
+		oldest->skip(sizeof(LogRecord));
+		oldest->getData((unsigned char*)text, record.m_length);
+
+		output(record.m_level, record.m_time, text, record.m_length);
+		written = true;
+	}
+
+	unsigned int dropped = m_dropped.load(std::memory_order_relaxed);
+	if (dropped != m_reported) {
+		char text[100U];
+		int length = ::sprintf(text, "%u log records have been dropped, the log queue was full", dropped - m_reported);
+		output(4U, CTimestamp::getTime(), text, (unsigned int)length);
+		m_reported = dropped;
+		written = true;
+	}
+
+	if (written)
+		::fflush(stdout);
+
+	return written;
+}
+
+// Stops the logger thread once it has written everything queued. Anything
+// queued while it was stopping is written here, after that logging is direct.
+static void stopThread()
+{
+	if (m_thread == nullptr)
+		return;
+
+	m_thread->stop();
+
+	m_async = false;
+
+	m_thread->drain();
+
+	delete m_thread;
+	m_thread = nullptr;
+}
+
+// Queues a record for the logger thread, or writes it straight away
+static void queueRecord(unsigned int level, const char* text, unsigned int length)
+{
+	if (length > LOG_BLOCK_LENGTH)
+		length = LOG_BLOCK_LENGTH;
+
+	LogRecord record;
+	record.m_time   = CTimestamp::getTime();
+	record.m_level  = level;
+	record.m_length = length;
+
+	// Write out everything before the last record, it may explain it
+	if (level == 6U) {		// Fatal
+		stopThread();
+
+		output(level, record.m_time, text, length);
+		::fflush(stdout);
+
+		exit(1);
+	}
+
+	// The logger thread does the rest, unless it is not running
+	CRingBuffer<unsigned char>* queue = m_async ? getQueue() : nullptr;
+	if (queue == nullptr) {
+		output(level, record.m_time, text, length);
+		::fflush(stdout);
+		return;
+	}
+
+	if (!queue->hasSpace(sizeof(LogRecord) + length)) {
+		m_dropped.fetch_add(1U, std::memory_order_relaxed);
+		return;
+	}
+
+	queue->putData(0U, (unsigned char*)&record, sizeof(LogRecord));
+	queue->putData(sizeof(LogRecord), (const unsigned char*)text, length);
+	queue->commit(sizeof(LogRecord) + length);
+
+	wakeLogger();
+}
+
 void LogInitialise(unsigned int displayLevel, unsigned int mqttLevel)
 {
 	m_mqttLevel    = mqttLevel;
 	m_displayLevel = displayLevel;
+
+	// Already running after a restart
+	if (m_thread != nullptr)
+		return;
+
+	m_thread = new CLogThread;
+	m_thread->run();
+
+	m_async = true;
 }
 
 void LogFinalise()
 {
+	stopThread();
+
 	if (m_mqtt != nullptr) {
 		m_mqtt->close();
 		delete m_mqtt;
 		m_mqtt = nullptr;
 	}
+
+	freeQueues();
 }
 
 void Log(unsigned int level, const char* fmt, ...)
 {
 	assert(fmt != nullptr);
 
-	char buffer[501U];
-#if defined(_WIN32) || defined(_WIN64)
-	SYSTEMTIME st;
-	::GetSystemTime(&st);
+	PROFILE_ZONE(ZONE::LOG);
 
-	::sprintf(buffer, "%c: %04u-%02u-%02u %02u:%02u:%02u.%03u ", LEVELS[level], st.wYear, st.wMonth, st.wDay, st.wHour, st.wMinute, st.wSecond, st.wMilliseconds);
-#else
-	struct timeval now;
-	::gettimeofday(&now, nullptr);
-
-	struct tm* tm = ::gmtime(&now.tv_sec);
-
-	::sprintf(buffer, "%c: %04d-%02d-%02d %02d:%02d:%02d.%03lld ", LEVELS[level], tm->tm_year + 1900, tm->tm_mon + 1, tm->tm_mday, tm->tm_hour, tm->tm_min, tm->tm_sec, now.tv_usec / 1000LL);
-#endif
+	char text[LOG_TEXT_LENGTH];
 
 	va_list vl;
 	va_start(vl, fmt);
 
-	::vsnprintf(buffer + ::strlen(buffer), 500 - ::strlen(buffer), fmt, vl);
+	int length = ::vsnprintf(text, LOG_TEXT_LENGTH, fmt, vl);
 
 	va_end(vl);
 
-	if (m_mqtt != nullptr && level >= m_mqttLevel && m_mqttLevel != 0U)
-		m_mqtt->publish("log", buffer);
+	if (length < 0)
+		return;
 
-	if (level >= m_displayLevel && m_displayLevel != 0U) {
-		::fprintf(stdout, "%s\n", buffer);
-		::fflush(stdout);
-	}
+	if (length >= int(LOG_TEXT_LENGTH))
+		length = int(LOG_TEXT_LENGTH - 1U);
 
-	if (level == 6U)		// Fatal
-		exit(1);
+	queueRecord(level, text, (unsigned int)length);
+}
+
+void LogText(unsigned int level, const char* text, unsigned int length)
+{
+	assert(text != nullptr);
+
+	PROFILE_ZONE(ZONE::LOG);
+
+	queueRecord(level, text, length);
 }
 
 void WriteJSON(const std::string& topLevel, nlohmann::json& json)
 {
+	PROFILE_ZONE(ZONE::JSON);
+
 	if (m_mqtt != nullptr) {
 		nlohmann::json top;
 
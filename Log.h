@@ -30,8 +30,14 @@
 #define	LogError(fmt, ...)	Log(5U, fmt, ##__VA_ARGS__)
 #define	LogFatal(fmt, ...)	Log(6U, fmt, ##__VA_ARGS__)
 
+// The longest record, which may have several lines
+const unsigned int LOG_BLOCK_LENGTH = 4096U;
+
 extern void Log(unsigned int level, const char* fmt, ...);
 
+// Logs text that is already formatted, without a copy through printf
+extern void LogText(unsigned int level, const char* text, unsigned int length);
+
 extern void LogInitialise(unsigned int displayLevel, unsigned int mqttLevel);
 extern void LogFinalise();
 
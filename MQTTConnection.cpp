@@ -17,6 +17,9 @@
  */
 
 #include "MQTTConnection.h"
+#include "StopWatch.h"
+#include "Metrics.h"
+#include "Profile.h"
 
 #include <cassert>
 #include <cstdio>
@@ -28,7 +31,15 @@
 #include <unistd.h>
 #endif
 
-CMQTTConnection::CMQTTConnection(const std::string& host, unsigned short port, const std::string& name, const bool authEnabled, const std::string& username, const std::string& password, const std::vector<std::pair<std::string, void (*)(const unsigned char*, unsigned int)>>& subs, unsigned int keepalive, MQTT_QOS qos) :
+// Must be a power of two
+const unsigned int MID_SLOTS = 1024U;
+
+// Marks a slot whose acknowledgement arrived before the start time was stored
+const unsigned long long ACK_EARLY = 1ULL;
+
+static thread_local unsigned long long m_messageTime = 0ULL;
+
+CMQTTConnection::CMQTTConnection(const std::string& host, unsigned short port, const std::string& name, const bool authEnabled, const std::string& username, const std::string& password, const std::vector<std::pair<std::string, void (*)(const char*, const unsigned char*, unsigned int)>>& subs, unsigned int keepalive, MQTT_QOS qos) :
 m_host(host),
 m_port(port),
 m_name(name),
@@ -36,22 +47,153 @@ m_authEnabled(authEnabled),
 m_username(username),
 m_password(password),
 m_subs(subs),
+m_topics(),
+m_topicsQoS(),
+m_shared(),
+m_trie(),
 m_keepalive(keepalive),
 m_qos(qos),
+m_publications(),
+m_willTopic(),
+m_willText(),
+m_willRetain(false),
+m_mutex(),
+m_inFlightWindow(0U),
+m_queueLimit(0U),
+m_reconnectDelay(1U),
+m_reconnectMaxDelay(30U),
+m_bufferSize(0U),
 m_mosq(nullptr),
-m_connected(false)
+m_connected(false),
+m_buffer(),
+m_bufferMutex(),
+m_disconnectTime(0ULL),
+m_reconnects(0U),
+m_disconnectedTime(0ULL),
+m_buffered(0U),
+m_bufferDropped(0U),
+m_ackStart(nullptr),
+m_inFlight(0U),
+m_inFlightPeak(0U),
+m_dropped(0U),
+m_ackCount(0U),
+m_ackTotal(0ULL),
+m_ackMax(0ULL)
 {
 	assert(!host.empty());
 	assert(port > 0U);
 	assert(!name.empty());
 	assert(keepalive >= 5U);
 
+	m_ackStart = new std::atomic<unsigned long long>[MID_SLOTS];
+	for (unsigned int i = 0U; i < MID_SLOTS; i++)
+		m_ackStart[i] = 0ULL;
+
 	::mosquitto_lib_init();
 }
 
 CMQTTConnection::~CMQTTConnection()
 {
 	::mosquitto_lib_cleanup();
+
+	delete[] m_ackStart;
+}
+
+CMQTTConnection::CPublication& CMQTTConnection::getPublication(const std::string& topic)
+{
+	for (std::vector<CPublication>::iterator it = m_publications.begin(); it != m_publications.end(); ++it) {
+		if ((*it).m_name == topic)
+			return *it;
+	}
+
+	CPublication publication;
+	publication.m_name    = topic;
+	publication.m_topic   = (topic.find_first_of('/') == std::string::npos) ? (m_name + "/" + topic) : topic;
+	publication.m_qos     = m_qos;
+	publication.m_retain  = false;
+	publication.m_format  = MQTT_BATCH::NONE;
+	publication.m_maxSize = 0U;
+	publication.m_linger  = 0U;
+	publication.m_age     = 0U;
+
+	m_publications.push_back(publication);
+
+	return m_publications.back();
+}
+
+CMQTTConnection::CPublication* CMQTTConnection::findPublication(const char* topic)
+{
+	for (std::vector<CPublication>::iterator it = m_publications.begin(); it != m_publications.end(); ++it) {
+		if ((*it).m_name == topic)
+			return &(*it);
+	}
+
+	return nullptr;
+}
+
+void CMQTTConnection::setQoS(const std::string& topic, MQTT_QOS qos)
+{
+	assert(!topic.empty());
+
+	getPublication(topic).m_qos = qos;
+}
+
+void CMQTTConnection::setBatching(const std::string& topic, MQTT_BATCH format, unsigned int maxSize, unsigned int linger)
+{
+	assert(!topic.empty());
+	assert(maxSize > 0U);
+
+	CPublication& publication = getPublication(topic);
+	publication.m_format  = format;
+	publication.m_maxSize = maxSize;
+	publication.m_linger  = linger;
+}
+
+void CMQTTConnection::setInFlight(unsigned int window, unsigned int queueLimit)
+{
+	m_inFlightWindow = window;
+	m_queueLimit     = queueLimit;
+}
+
+void CMQTTConnection::setReconnect(unsigned int delay, unsigned int maxDelay, unsigned int bufferSize)
+{
+	assert(delay > 0U);
+	assert(maxDelay >= delay);
+
+	m_reconnectDelay    = delay;
+	m_reconnectMaxDelay = maxDelay;
+	m_bufferSize        = bufferSize;
+}
+
+void CMQTTConnection::setShared(const std::string& topic, const std::string& group)
+{
+	assert(!topic.empty());
+	assert(!group.empty());
+
+	m_shared.push_back(std::make_pair(topic, group));
+}
+
+void CMQTTConnection::setRetain(const std::string& topic, bool retain)
+{
+	assert(!topic.empty());
+
+	getPublication(topic).m_retain = retain;
+}
+
+void CMQTTConnection::setWill(const std::string& topic, const std::string& text, bool retain)
+{
+	assert(!topic.empty());
+
+	m_willTopic  = topic;
+	m_willText   = text;
+	m_willRetain = retain;
+}
+
+MQTT_QOS CMQTTConnection::getQoS(const char* topic)
+{
+	CPublication* publication = findPublication(topic);
+
+	return (publication != nullptr) ? publication->m_qos : m_qos;
 }
 
 bool CMQTTConnection::open()
@@ -65,6 +207,34 @@ bool CMQTTConnection::open()
 
 	::fprintf(stdout, "APRSGateway (%s) connecting to MQTT as %s\n", m_name.c_str(), name);
 
+	for (std::vector<CPublication>::iterator it = m_publications.begin(); it != m_publications.end(); ++it) {
+		if ((*it).m_format != MQTT_BATCH::NONE)
+			(*it).m_batch.reserve((*it).m_maxSize + 2U);
+	}
+
+	// Expand the subscriptions into full topic filters once, rather than for every message
+	m_topics.clear();
+	m_topicsQoS.clear();
+	m_trie.clear();
+	for (std::vector<std::pair<std::string, void (*)(const char*, const unsigned char*, unsigned int)>>::const_iterator it = m_subs.cbegin(); it != m_subs.cend(); ++it) {
+		const std::string& topic = (*it).first;
+
+		std::string filter = (topic.find_first_of('/') == std::string::npos) ? (m_name + "/" + topic) : topic;
+
+		// The messages on a shared subscription arrive with the topic they were published on
+		m_trie.add(filter, int(m_topics.size()));
+
+		for (std::vector<std::pair<std::string, std::string>>::const_iterator it2 = m_shared.cbegin(); it2 != m_shared.cend(); ++it2) {
+			if ((*it2).first == topic) {
+				filter = "$share/" + (*it2).second + "/" + filter;
+				break;
+			}
+		}
+
+		m_topics.push_back(filter);
+		m_topicsQoS.push_back(getQoS(topic.c_str()));
+	}
+
 	m_mosq = ::mosquitto_new(name, true, this);
 	if (m_mosq == nullptr){
 		::fprintf(stderr, "MQTT Error newing: Out of memory.\n");
@@ -74,13 +244,34 @@ bool CMQTTConnection::open()
 	if (m_authEnabled)
 		::mosquitto_username_pw_set(m_mosq, m_username.c_str(), m_password.c_str());
 
+	// Published by the broker if we disappear without disconnecting
+	if (!m_willTopic.empty()) {
+		std::string topic = (m_willTopic.find_first_of('/') == std::string::npos) ? (m_name + "/" + m_willTopic) : m_willTopic;
+		::mosquitto_will_set(m_mosq, topic.c_str(), int(m_willText.size()), m_willText.c_str(), static_cast<int>(getQoS(m_willTopic.c_str())), m_willRetain);
+	}
+
+	// Shared subscriptions are part of MQTT v5
+	if (!m_shared.empty())
+		::mosquitto_int_option(m_mosq, MOSQ_OPT_PROTOCOL_VERSION, MQTT_PROTOCOL_V5);
+
+	if (m_inFlightWindow > 0U)
+		::mosquitto_int_option(m_mosq, MOSQ_OPT_SEND_MAXIMUM, int(m_inFlightWindow));
+
+	// Back off exponentially between reconnection attempts
+	::mosquitto_reconnect_delay_set(m_mosq, m_reconnectDelay, m_reconnectMaxDelay, true);
+
 	::mosquitto_connect_callback_set(m_mosq, onConnect);
 	::mosquitto_subscribe_callback_set(m_mosq, onSubscribe);
 	::mosquitto_message_callback_set(m_mosq, onMessage);
 	::mosquitto_disconnect_callback_set(m_mosq, onDisconnect);
+	::mosquitto_publish_callback_set(m_mosq, onPublish);
 
+	// A broker that can't be reached yet is retried by the loop thread, as after a
+	// disconnect, so that the frames that don't need MQTT still flow
 	int rc = ::mosquitto_connect(m_mosq, m_host.c_str(), m_port, m_keepalive);
-	if (rc != MOSQ_ERR_SUCCESS) {
+	if (rc == MOSQ_ERR_ERRNO || rc == MOSQ_ERR_EAI) {
+		::fprintf(stderr, "MQTT Error connecting: %s, will keep trying\n", ::mosquitto_strerror(rc));
+	} else if (rc != MOSQ_ERR_SUCCESS) {
 		::mosquitto_destroy(m_mosq);
 		m_mosq = nullptr;
 		::fprintf(stderr, "MQTT Error connecting: %s\n", ::mosquitto_strerror(rc));
@@ -119,32 +310,299 @@ bool CMQTTConnection::publish(const char* topic, const unsigned char* data, unsi
 	assert(topic != nullptr);
 	assert(data != nullptr);
 
-	if (!m_connected)
-		return false;
+	// The publications are only added before open(), so this needs no locking
+	CPublication* publication = findPublication(topic);
+	if (publication != nullptr) {
+		if (publication->m_format != MQTT_BATCH::NONE)
+			return addToBatch(*publication, data, len);
+
+		return send(publication->m_topic.c_str(), data, len, publication->m_qos, publication->m_retain);
+	}
 
 	if (::strchr(topic, '/') == nullptr) {
 		char topicEx[100U];
 		::sprintf(topicEx, "%s/%s", m_name.c_str(), topic);
 
-		int rc = ::mosquitto_publish(m_mosq, nullptr, topicEx, len, data, static_cast<int>(m_qos), false);
-		if (rc != MOSQ_ERR_SUCCESS) {
-			::fprintf(stderr, "MQTT Error publishing: %s\n", ::mosquitto_strerror(rc));
-			return false;
-		}
-	} else {
-		int rc = ::mosquitto_publish(m_mosq, nullptr, topic, len, data, static_cast<int>(m_qos), false);
-		if (rc != MOSQ_ERR_SUCCESS) {
-			::fprintf(stderr, "MQTT Error publishing: %s\n", ::mosquitto_strerror(rc));
-			return false;
+		return send(topicEx, data, len, m_qos);
+	}
+
+	return send(topic, data, len, m_qos);
+}
+
+bool CMQTTConnection::send(const char* topic, const unsigned char* data, unsigned int len, MQTT_QOS qos, bool retain)
+{
+	assert(topic != nullptr);
+	assert(data != nullptr);
+
+	// Hold on to messages while the broker is away, the oldest are lost first
+	m_bufferMutex.lock();
+	if (!m_connected) {
+		bool ret = false;
+
+		if (m_bufferSize > 0U) {
+			if (m_buffer.size() >= m_bufferSize) {
+				m_buffer.pop_front();
+				m_bufferDropped++;
+				CMetrics::increment(METRIC::MQTT_PUBLISH_FAILURES);
+			}
+
+			CBufferedMessage message;
+			message.m_topic  = topic;
+			message.m_data.assign((const char*)data, len);
+			message.m_qos    = qos;
+			message.m_retain = retain;
+			m_buffer.push_back(message);
+
+			m_buffered++;
+			ret = true;
+		} else {
+			CMetrics::increment(METRIC::MQTT_PUBLISH_FAILURES);
 		}
+
+		m_bufferMutex.unlock();
+		return ret;
+	}
+	m_bufferMutex.unlock();
+
+	// Don't let messages build up without limit when the broker is slow
+	if (m_queueLimit > 0U && m_inFlight.load(std::memory_order_relaxed) >= m_queueLimit) {
+		m_dropped.fetch_add(1U, std::memory_order_relaxed);
+		CMetrics::increment(METRIC::MQTT_PUBLISH_FAILURES);
+		return false;
+	}
+
+	unsigned long long start = CStopWatch::getMicroseconds();
+
+	unsigned int inFlight = m_inFlight.fetch_add(1U, std::memory_order_relaxed) + 1U;
+	if (inFlight > m_inFlightPeak.load(std::memory_order_relaxed))
+		m_inFlightPeak.store(inFlight, std::memory_order_relaxed);
+
+	int mid = 0;
+	int rc = ::mosquitto_publish(m_mosq, &mid, topic, len, data, static_cast<int>(qos), retain);
+	if (rc != MOSQ_ERR_SUCCESS) {
+		released();
+		::fprintf(stderr, "MQTT Error publishing: %s\n", ::mosquitto_strerror(rc));
+		CMetrics::increment(METRIC::MQTT_PUBLISH_FAILURES);
+		return false;
 	}
 
+	published(mid, start);
+
 	return true;
 }
 
+bool CMQTTConnection::addToBatch(CPublication& publication, const unsigned char* data, unsigned int len)
+{
+	unsigned int itemLength = len;
+	if (publication.m_format == MQTT_BATCH::JSON_ARRAY) {
+		// Allow for the quotes and any escaping of the text
+		itemLength += 2U;
+		for (unsigned int i = 0U; i < len; i++) {
+			if (data[i] == '"' || data[i] == '\\')
+				itemLength += 1U;
+			else if (data[i] < 0x20U)
+				itemLength += 5U;
+		}
+	}
+
+	bool ret = true;
+
+	m_mutex.lock();
+
+	// The extra two allow for a separator and the closing bracket
+	if (!publication.m_batch.empty() && (publication.m_batch.size() + itemLength + 2U) > publication.m_maxSize)
+		ret = sendBatch(publication);
+
+	if (publication.m_format == MQTT_BATCH::JSON_ARRAY) {
+		publication.m_batch += publication.m_batch.empty() ? '[' : ',';
+		publication.m_batch += '"';
+
+		for (unsigned int i = 0U; i < len; i++) {
+			unsigned char c = data[i];
+			if (c == '"' || c == '\\') {
+				publication.m_batch += '\\';
+				publication.m_batch += char(c);
+			} else if (c < 0x20U) {
+				char temp[10U];
+				::sprintf(temp, "\\u%04X", c);
+				publication.m_batch += temp;
+			} else {
+				publication.m_batch += char(c);
+			}
+		}
+
+		publication.m_batch += '"';
+	} else {
+		if (!publication.m_batch.empty())
+			publication.m_batch += '\n';
+
+		publication.m_batch.append((const char*)data, len);
+	}
+
+	if (publication.m_batch.size() >= publication.m_maxSize || publication.m_linger == 0U) {
+		bool ret2 = sendBatch(publication);
+		ret = ret && ret2;
+	}
+
+	m_mutex.unlock();
+
+	return ret;
+}
+
+bool CMQTTConnection::sendBatch(CPublication& publication)
+{
+	if (publication.m_batch.empty())
+		return true;
+
+	if (publication.m_format == MQTT_BATCH::JSON_ARRAY)
+		publication.m_batch += ']';
+
+	bool ret = send(publication.m_topic.c_str(), (const unsigned char*)publication.m_batch.data(), (unsigned int)publication.m_batch.size(), publication.m_qos, publication.m_retain);
+
+	publication.m_batch.clear();
+	publication.m_age = 0U;
+
+	return ret;
+}
+
+void CMQTTConnection::clock(unsigned int ms)
+{
+	m_mutex.lock();
+
+	for (std::vector<CPublication>::iterator it = m_publications.begin(); it != m_publications.end(); ++it) {
+		if ((*it).m_format == MQTT_BATCH::NONE || (*it).m_batch.empty())
+			continue;
+
+		(*it).m_age += ms;
+		if ((*it).m_age >= (*it).m_linger)
+			sendBatch(*it);
+	}
+
+	m_mutex.unlock();
+}
+
+void CMQTTConnection::published(int mid, unsigned long long start)
+{
+	std::atomic<unsigned long long>& slot = m_ackStart[(unsigned int)mid & (MID_SLOTS - 1U)];
+
+	unsigned long long expected = 0ULL;
+	if (slot.compare_exchange_strong(expected, start))
+		return;
+
+	// The acknowledgement beat us here
+	if (expected == ACK_EARLY) {
+		slot.store(0ULL);
+		acknowledged(start, CStopWatch::getMicroseconds());
+	}
+}
+
+// Messages that libmosquitto throws away on a disconnect are never acknowledged,
+// so the count starts again from zero then. Late acknowledgements of the others
+// mustn't take it below zero.
+void CMQTTConnection::released()
+{
+	unsigned int inFlight = m_inFlight.load(std::memory_order_relaxed);
+	while (inFlight > 0U && !m_inFlight.compare_exchange_weak(inFlight, inFlight - 1U, std::memory_order_relaxed))
+		;
+}
+
+void CMQTTConnection::acknowledged(unsigned long long start, unsigned long long end)
+{
+	unsigned long long latency = end - start;
+
+	m_ackCount.fetch_add(1U, std::memory_order_relaxed);
+	m_ackTotal.fetch_add(latency, std::memory_order_relaxed);
+
+	if (latency > m_ackMax.load(std::memory_order_relaxed))
+		m_ackMax.store(latency, std::memory_order_relaxed);
+}
+
+unsigned int CMQTTConnection::getInFlight() const
+{
+	return m_inFlight.load(std::memory_order_relaxed);
+}
+
+unsigned int CMQTTConnection::getInFlightPeak() const
+{
+	return m_inFlightPeak.load(std::memory_order_relaxed);
+}
+
+unsigned int CMQTTConnection::getDropped() const
+{
+	return m_dropped.load(std::memory_order_relaxed);
+}
+
+unsigned int CMQTTConnection::getAckCount() const
+{
+	return m_ackCount.load(std::memory_order_relaxed);
+}
+
+unsigned long long CMQTTConnection::getAckLatencyMean() const
+{
+	unsigned int count = m_ackCount.load(std::memory_order_relaxed);
+	if (count == 0U)
+		return 0ULL;
+
+	return m_ackTotal.load(std::memory_order_relaxed) / count;
+}
+
+unsigned long long CMQTTConnection::getAckLatencyMax() const
+{
+	return m_ackMax.load(std::memory_order_relaxed);
+}
+
+unsigned int CMQTTConnection::getReconnects() const
+{
+	return m_reconnects;
+}
+
+unsigned long long CMQTTConnection::getDisconnectedTime() const
+{
+	return m_disconnectedTime;
+}
+
+unsigned int CMQTTConnection::getBuffered() const
+{
+	return m_buffered;
+}
+
+unsigned int CMQTTConnection::getBufferDropped() const
+{
+	return m_bufferDropped;
+}
+
+void CMQTTConnection::sendBuffered()
+{
+	std::deque<CBufferedMessage> buffer;
+
+	// Mark the connection as up and take the buffer in one step, so that nothing is left behind
+	m_bufferMutex.lock();
+	m_connected = true;
+	buffer.swap(m_buffer);
+	m_bufferMutex.unlock();
+
+	if (m_disconnectTime > 0ULL) {
+		unsigned long long duration = CStopWatch::getMicroseconds() / 1000ULL - m_disconnectTime;
+		m_disconnectedTime += duration;
+		m_reconnects++;
+
+		::fprintf(stdout, "MQTT: reconnected after %llu ms, sending %u buffered messages, %u dropped in total\n", duration, (unsigned int)buffer.size(), m_bufferDropped);
+		m_disconnectTime = 0ULL;
+	}
+
+	for (std::deque<CBufferedMessage>::const_iterator it = buffer.cbegin(); it != buffer.cend(); ++it)
+		send((*it).m_topic.c_str(), (const unsigned char*)(*it).m_data.data(), (unsigned int)(*it).m_data.size(), (*it).m_qos, (*it).m_retain);
+}
+
 void CMQTTConnection::close()
 {
 	if (m_mosq != nullptr) {
+		// Send whatever is waiting in the batches
+		m_mutex.lock();
+		for (std::vector<CPublication>::iterator it = m_publications.begin(); it != m_publications.end(); ++it)
+			sendBatch(*it);
+		m_mutex.unlock();
+
 		::mosquitto_disconnect(m_mosq);
 		::mosquitto_loop_stop(m_mosq, true);
 		::mosquitto_destroy(m_mosq);
@@ -152,6 +610,15 @@ void CMQTTConnection::close()
 	}
 }
 
+bool CMQTTConnection::isConnected()
+{
+	m_bufferMutex.lock();
+	bool connected = m_connected;
+	m_bufferMutex.unlock();
+
+	return connected;
+}
+
 void CMQTTConnection::onConnect(mosquitto* mosq, void* obj, int rc)
 {
 	assert(mosq != nullptr);
@@ -164,31 +631,19 @@ void CMQTTConnection::onConnect(mosquitto* mosq, void* obj, int rc)
 	}
 
 	CMQTTConnection* p = static_cast<CMQTTConnection*>(obj);
-	p->m_connected = true;
 
-	for (std::vector<std::pair<std::string, void (*)(const unsigned char*, unsigned int)>>::const_iterator it = p->m_subs.cbegin(); it != p->m_subs.cend(); ++it) {
-		std::string topic = (*it).first;
-
-		if (topic.find_first_of('/') == std::string::npos) {
-			char topicEx[100U];
-			::sprintf(topicEx, "%s/%s", p->m_name.c_str(), topic.c_str());
-
-			rc = ::mosquitto_subscribe(mosq, nullptr, topicEx, static_cast<int>(p->m_qos));
-			if (rc != MOSQ_ERR_SUCCESS) {
-				::fprintf(stderr, "MQTT: error subscribing to %s - %s\n", topicEx, ::mosquitto_strerror(rc));
-				::mosquitto_disconnect(mosq);
-			}
-		} else {
-			rc = ::mosquitto_subscribe(mosq, nullptr, topic.c_str(), static_cast<int>(p->m_qos));
-			if (rc != MOSQ_ERR_SUCCESS) {
-				::fprintf(stderr, "MQTT: error subscribing to %s - %s\n", topic.c_str(), ::mosquitto_strerror(rc));
-				::mosquitto_disconnect(mosq);
-			}
+	for (unsigned int i = 0U; i < p->m_topics.size(); i++) {
+		rc = ::mosquitto_subscribe(mosq, nullptr, p->m_topics[i].c_str(), static_cast<int>(p->m_topicsQoS[i]));
+		if (rc != MOSQ_ERR_SUCCESS) {
+			::fprintf(stderr, "MQTT: error subscribing to %s - %s\n", p->m_topics[i].c_str(), ::mosquitto_strerror(rc));
+			::mosquitto_disconnect(mosq);
 		}
 	}
+
+	p->sendBuffered();
 }
 
-void CMQTTConnection::onSubscribe(mosquitto* mosq, void* obj, int mid, int qosCount, const int* grantedQOS)
+void CMQTTConnection::onSubscribe(mosquitto* mosq, void* obj, int, int qosCount, const int* grantedQOS)
 {
 	assert(mosq != nullptr);
 	assert(obj != nullptr);
@@ -198,25 +653,26 @@ void CMQTTConnection::onSubscribe(mosquitto* mosq, void* obj, int mid, int qosCo
 		::fprintf(stdout, "MQTT: on_subscribe: %d:%d\n", i, grantedQOS[i]);
 }
 
+unsigned long long CMQTTConnection::getMessageTime()
+{
+	return m_messageTime;
+}
+
 void CMQTTConnection::onMessage(mosquitto* mosq, void* obj, const mosquitto_message* message)
 {
 	assert(mosq != nullptr);
 	assert(obj != nullptr);
 	assert(message != nullptr);
 
-	CMQTTConnection* p = static_cast<CMQTTConnection*>(obj);
+	m_messageTime = CStopWatch::getMicroseconds();
 
-	for (std::vector<std::pair<std::string, void (*)(const unsigned char*, unsigned int)>>::const_iterator it = p->m_subs.cbegin(); it != p->m_subs.cend(); ++it) {
-		std::string topic = (*it).first;
+	PROFILE_THREAD("mqtt");
 
-		char topicEx[100U];
-		::sprintf(topicEx, "%s/%s", p->m_name.c_str(), topic.c_str());
+	CMQTTConnection* p = static_cast<CMQTTConnection*>(obj);
 
-		if (::strcmp(topicEx, message->topic) == 0) {
-			(*it).second((unsigned char*)message->payload, message->payloadlen);
-			break;
-		}
-	}
+	int n = p->m_trie.match(message->topic);
+	if (n >= 0)
+		p->m_subs[n].second(message->topic, (unsigned char*)message->payload, message->payloadlen);
 }
 
 void CMQTTConnection::onDisconnect(mosquitto* mosq, void* obj, int rc)
@@ -227,6 +683,34 @@ void CMQTTConnection::onDisconnect(mosquitto* mosq, void* obj, int rc)
 	::fprintf(stdout, "MQTT: on_disconnect: %s\n", ::mosquitto_reason_string(rc));
 
 	CMQTTConnection* p = static_cast<CMQTTConnection*>(obj);
+
+	p->m_bufferMutex.lock();
 	p->m_connected = false;
+	p->m_bufferMutex.unlock();
+
+	p->m_inFlight.store(0U, std::memory_order_relaxed);
+
+	if (p->m_disconnectTime == 0ULL)
+		p->m_disconnectTime = CStopWatch::getMicroseconds() / 1000ULL;
 }
 
+
+void CMQTTConnection::onPublish(mosquitto* mosq, void* obj, int mid)
+{
+	assert(mosq != nullptr);
+	assert(obj != nullptr);
+
+	CMQTTConnection* p = static_cast<CMQTTConnection*>(obj);
+
+	p->released();
+
+	std::atomic<unsigned long long>& slot = p->m_ackStart[(unsigned int)mid & (MID_SLOTS - 1U)];
+
+	unsigned long long start = slot.load();
+	if (start > ACK_EARLY) {
+		if (slot.compare_exchange_strong(start, 0ULL))
+			p->acknowledged(start, CStopWatch::getMicroseconds());
+	} else if (start == 0ULL) {
+		slot.compare_exchange_strong(start, ACK_EARLY);
+	}
+}
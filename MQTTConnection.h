@@ -19,8 +19,13 @@
 #if !defined(MQTTPUBLISHER_H)
 #define	MQTTPUBLISHER_H
 
+#include "MQTTTopicTrie.h"
+#include "Mutex.h"
+
 #include <mosquitto.h>
 
+#include <atomic>
+#include <deque>
 #include <vector>
 #include <string>
 
@@ -30,36 +35,130 @@ enum class MQTT_QOS : int  {
 	EXACTLY_ONCE  = 2
 };
 
+enum class MQTT_BATCH : int {
+	NONE       = 0,
+	LINES      = 1,
+	JSON_ARRAY = 2
+};
+
 class CMQTTConnection {
 public:
-	CMQTTConnection(const std::string& host, unsigned short port, const std::string& name, const bool authEnabled, const std::string& username, const std::string& password, const std::vector<std::pair<std::string, void (*)(const unsigned char*, unsigned int)>>& subs, unsigned int keepalive, MQTT_QOS qos = MQTT_QOS::EXACTLY_ONCE);
+	CMQTTConnection(const std::string& host, unsigned short port, const std::string& name, const bool authEnabled, const std::string& username, const std::string& password, const std::vector<std::pair<std::string, void (*)(const char*, const unsigned char*, unsigned int)>>& subs, unsigned int keepalive, MQTT_QOS qos = MQTT_QOS::EXACTLY_ONCE);
 	~CMQTTConnection();
 
+	// These must be called before open()
+	void setQoS(const std::string& topic, MQTT_QOS qos);
+	void setInFlight(unsigned int window, unsigned int queueLimit);
+	void setBatching(const std::string& topic, MQTT_BATCH format, unsigned int maxSize, unsigned int linger);
+	void setReconnect(unsigned int delay, unsigned int maxDelay, unsigned int bufferSize);
+	void setShared(const std::string& topic, const std::string& group);
+	void setRetain(const std::string& topic, bool retain);
+	void setWill(const std::string& topic, const std::string& text, bool retain);
+
 	bool open();
 
 	bool publish(const char* topic, const char* text);
 	bool publish(const char* topic, const std::string& text);
 	bool publish(const char* topic, const unsigned char* data, unsigned int len);
 
+	// Sends any batches that have waited for longer than their linger time
+	void clock(unsigned int ms);
+
 	void close();
 
+	bool isConnected();
+
+	// When the message being passed to a subscriber arrived, in microseconds,
+	// only valid in the subscriber's callback
+	static unsigned long long getMessageTime();
+
+	unsigned int       getInFlight() const;
+	unsigned int       getInFlightPeak() const;
+	unsigned int       getDropped() const;
+	unsigned int       getAckCount() const;
+	unsigned long long getAckLatencyMean() const;
+	unsigned long long getAckLatencyMax() const;
+	unsigned int       getReconnects() const;
+	unsigned long long getDisconnectedTime() const;
+	unsigned int       getBuffered() const;
+	unsigned int       getBufferDropped() const;
+
 private:
+	struct CPublication {
+		std::string  m_name;
+		std::string  m_topic;
+		MQTT_QOS     m_qos;
+		bool         m_retain;
+		MQTT_BATCH   m_format;
+		unsigned int m_maxSize;
+		unsigned int m_linger;
+		std::string  m_batch;
+		unsigned int m_age;
+	};
+
+	struct CBufferedMessage {
+		std::string m_topic;
+		std::string m_data;
+		MQTT_QOS    m_qos;
+		bool        m_retain;
+	};
+
 	std::string    m_host;
 	unsigned short m_port;
 	std::string    m_name;
 	bool           m_authEnabled;
 	std::string    m_username;
 	std::string    m_password;
-	std::vector<std::pair<std::string, void (*)(const unsigned char*, unsigned int)>> m_subs;
+	std::vector<std::pair<std::string, void (*)(const char*, const unsigned char*, unsigned int)>> m_subs;
+	std::vector<std::string> m_topics;
+	std::vector<MQTT_QOS> m_topicsQoS;
+	std::vector<std::pair<std::string, std::string>> m_shared;
+	CMQTTTopicTrie m_trie;
 	unsigned int   m_keepalive;
 	MQTT_QOS       m_qos;
+	std::vector<CPublication> m_publications;
+	std::string    m_willTopic;
+	std::string    m_willText;
+	bool           m_willRetain;
+	CMutex         m_mutex;
+	unsigned int   m_inFlightWindow;
+	unsigned int   m_queueLimit;
+	unsigned int   m_reconnectDelay;
+	unsigned int   m_reconnectMaxDelay;
+	unsigned int   m_bufferSize;
 	mosquitto*     m_mosq;
 	bool           m_connected;
+	std::deque<CBufferedMessage> m_buffer;
+	CMutex         m_bufferMutex;
+	unsigned long long m_disconnectTime;
+	unsigned int   m_reconnects;
+	unsigned long long m_disconnectedTime;
+	unsigned int   m_buffered;
+	unsigned int   m_bufferDropped;
+	std::atomic<unsigned long long>* m_ackStart;
+	std::atomic<unsigned int>        m_inFlight;
+	std::atomic<unsigned int>        m_inFlightPeak;
+	std::atomic<unsigned int>        m_dropped;
+	std::atomic<unsigned int>        m_ackCount;
+	std::atomic<unsigned long long>  m_ackTotal;
+	std::atomic<unsigned long long>  m_ackMax;
+
+	CPublication& getPublication(const std::string& topic);
+	CPublication* findPublication(const char* topic);
+	MQTT_QOS getQoS(const char* topic);
+	bool send(const char* topic, const unsigned char* data, unsigned int len, MQTT_QOS qos, bool retain = false);
+	bool addToBatch(CPublication& publication, const unsigned char* data, unsigned int len);
+	bool sendBatch(CPublication& publication);
+	void sendBuffered();
+	void published(int mid, unsigned long long start);
+	void released();
+	void acknowledged(unsigned long long start, unsigned long long end);
 
 	static void onConnect(mosquitto* mosq, void* obj, int rc);
 	static void onSubscribe(mosquitto* mosq, void* obj, int mid, int qosCount, const int* grantedQOS);
 	static void onMessage(mosquitto* mosq, void* obj, const mosquitto_message* message);
 	static void onDisconnect(mosquitto* mosq, void* obj, int rc);
+	static void onPublish(mosquitto* mosq, void* obj, int mid);
 };
 
 #endif
@@ -0,0 +1,158 @@
+/*
+ *   Copyright (C) 2026 by Jonathan Naylor G4KLX
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program; if not, write to the Free Software
+ *   Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+#include "MQTTTopicTrie.h"
+
+#include <cassert>
+#include <cstring>
+
+CMQTTTopicTrie::CMQTTTopicTrie() :
+m_nodes()
+{
+	addNode();
+}
+
+CMQTTTopicTrie::~CMQTTTopicTrie()
+{
+}
+
+void CMQTTTopicTrie::clear()
+{
+	m_nodes.clear();
+
+	addNode();
+}
+
+unsigned int CMQTTTopicTrie::addNode()
+{
+	CNode node;
+	node.m_plus  = -1;
+	node.m_hash  = -1;
+	node.m_value = -1;
+
+	m_nodes.push_back(node);
+
+	return (unsigned int)(m_nodes.size() - 1U);
+}
+
+void CMQTTTopicTrie::add(const std::string& filter, int value)
+{
+	assert(!filter.empty());
+	assert(value >= 0);
+
+	unsigned int node = 0U;
+
+	std::string::size_type start = 0U;
+	for (;;) {
+		std::string::size_type end = filter.find('/', start);
+		std::string segment = filter.substr(start, end == std::string::npos ? std::string::npos : end - start);
+
+		if (segment == "#") {
+			// A multi-level wildcard is always the last level of a filter
+			if (m_nodes[node].m_hash < 0)
+				m_nodes[node].m_hash = value;
+			return;
+		}
+
+		if (segment == "+") {
+			if (m_nodes[node].m_plus < 0) {
+				unsigned int child = addNode();
+				m_nodes[node].m_plus = int(child);
+			}
+
+			node = (unsigned int)m_nodes[node].m_plus;
+		} else {
+			unsigned int child = 0U;
+			for (std::vector<std::pair<std::string, unsigned int>>::const_iterator it = m_nodes[node].m_children.cbegin(); it != m_nodes[node].m_children.cend(); ++it) {
+				if ((*it).first == segment) {
+					child = (*it).second;
+					break;
+				}
+			}
+
+			if (child == 0U) {
+				child = addNode();
+				m_nodes[node].m_children.push_back(std::make_pair(segment, child));
+			}
+
+			node = child;
+		}
+
+		if (end == std::string::npos)
+			break;
+
+		start = end + 1U;
+	}
+
+	if (m_nodes[node].m_value < 0)
+		m_nodes[node].m_value = value;
+}
+
+int CMQTTTopicTrie::match(const char* topic) const
+{
+	assert(topic != nullptr);
+
+	return match(0U, topic, true);
+}
+
+int CMQTTTopicTrie::match(unsigned int node, const char* topic, bool first) const
+{
+	const CNode& n = m_nodes[node];
+
+	const char* end = ::strchr(topic, '/');
+	size_t length = (end != nullptr) ? size_t(end - topic) : ::strlen(topic);
+
+	// Topics beginning with $ are never matched by a wildcard at the first level
+	bool wildcards = !first || topic[0U] != '$';
+
+	for (std::vector<std::pair<std::string, unsigned int>>::const_iterator it = n.m_children.cbegin(); it != n.m_children.cend(); ++it) {
+		if ((*it).first.size() == length && ::memcmp((*it).first.data(), topic, length) == 0) {
+			int value;
+			if (end != nullptr) {
+				value = match((*it).second, end + 1, false);
+			} else {
+				// "a/#" also matches the parent level "a"
+				const CNode& child = m_nodes[(*it).second];
+				value = (child.m_value >= 0) ? child.m_value : child.m_hash;
+			}
+
+			if (value >= 0)
+				return value;
+
+			break;
+		}
+	}
+
+	if (!wildcards)
+		return -1;
+
+	if (n.m_plus >= 0) {
+		int value;
+		if (end != nullptr) {
+			value = match((unsigned int)n.m_plus, end + 1, false);
+		} else {
+			const CNode& child = m_nodes[n.m_plus];
+			value = (child.m_value >= 0) ? child.m_value : child.m_hash;
+		}
+
+		if (value >= 0)
+			return value;
+	}
+
+	return n.m_hash;
+}
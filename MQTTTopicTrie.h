@@ -0,0 +1,53 @@
+/*
+ *   Copyright (C) 2026 by Jonathan Naylor G4KLX
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program; if not, write to the Free Software
+ *   Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+#if !defined(MQTTTopicTrie_H)
+#define	MQTTTopicTrie_H
+
+#include <vector>
+#include <string>
+
+// Matches MQTT topic names against a set of topic filters, including the +
+// and # wildcards. The trie is built once and matching does not allocate.
+class CMQTTTopicTrie {
+public:
+	CMQTTTopicTrie();
+	~CMQTTTopicTrie();
+
+	void add(const std::string& filter, int value);
+
+	void clear();
+
+	// Returns the value of the most specific matching filter, or -1
+	int match(const char* topic) const;
+
+private:
+	struct CNode {
+		std::vector<std::pair<std::string, unsigned int>> m_children;
+		int m_plus;
+		int m_hash;
+		int m_value;
+	};
+
+	std::vector<CNode> m_nodes;
+
+	unsigned int addNode();
+	int match(unsigned int node, const char* topic, bool first) const;
+};
+
+#endif
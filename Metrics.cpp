@@ -0,0 +1,207 @@
+/*
+ *   Copyright (C) 2026 by Jonathan Naylor G4KLX
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program; if not, write to the Free Software
+ *   Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+#include "Metrics.h"
+#include "ThreadSlots.h"
+
+#include <atomic>
+#include <cassert>
+
+// Sets of counters and histograms, see CThreadSlots
+const unsigned int MAX_METRIC_THREADS = 32U;
+
+static const unsigned long long BOUNDS[HISTOGRAM_BUCKETS] = {
+	1000ULL, 2000ULL, 5000ULL, 10000ULL, 20000ULL, 50000ULL, 100000ULL,
+	200000ULL, 500000ULL, 1000000ULL, 2000000ULL, 5000000ULL, 10000000ULL, 0ULL
+};
+
+static const char* METRIC_NAMES[METRIC_COUNT] = {
+	"frames_in", "frames_out", "dropped_invalid", "dropped_duplicate", "dropped_over_share",
+	"dropped_queue_full", "dropped_discarded", "bytes_sent", "bytes_received", "connects",
+	"connect_failures", "mqtt_publish_failures", "tcp_retransmits", "send_queue_stalls"
+};
+
+static const char* METRIC_HELP[METRIC_COUNT] = {
+	"Frames received from all sources",
+	"Frames sent to APRS-IS",
+	"Frames rejected by the validator",
+	"Frames already sent by the cluster",
+	"Frames from a site over its share of the queue",
+	"Frames refused by a full queue",
+	"Frames too old to send, thrown away while on standby or not connected",
+	"Bytes sent to APRS-IS",
+	"Bytes received from APRS-IS",
+	"Connections made to APRS-IS",
+	"Failed connection attempts to APRS-IS",
+	"MQTT messages that could not be published",
+	"Segments retransmitted to APRS-IS",
+	"Times sending paused for the socket send queue to drain"
+};
+
+static const char* GAUGE_NAMES[GAUGE_COUNT] = {
+	"queue_depth", "aprs_connected", "aprs_enabled", "mqtt_connected", "tcp_rtt",
+	"tcp_rtt_var", "tcp_cwnd", "tcp_unacked", "tcp_send_queue", "tcp_unsent"
+};
+
+static const char* GAUGE_HELP[GAUGE_COUNT] = {
+	"Bytes waiting in the APRS-IS queue",
+	"Whether APRS-IS is connected",
+	"Whether APRS-IS should be connected, not on a standby",
+	"Whether the MQTT broker is connected",
+	"Smoothed round trip time to APRS-IS in microseconds",
+	"Variation of the round trip time in microseconds",
+	"Congestion window to APRS-IS in segments",
+	"Segments sent to APRS-IS but not acknowledged",
+	"Bytes in the socket waiting to be acknowledged by APRS-IS",
+	"Bytes in the socket not yet sent to APRS-IS"
+};
+
+static const char* HISTOGRAM_NAMES[HISTOGRAM_COUNT] = {
+	"connect_time", "queue_time"
+};
+
+static const char* HISTOGRAM_HELP[HISTOGRAM_COUNT] = {
+	"Time taken to connect and log in to APRS-IS",
+	"Time frames spend in the queue before being sent"
+};
+
+struct alignas(64) CThreadMetrics {
+	std::atomic<unsigned long long> m_counters[METRIC_COUNT];
+	std::atomic<unsigned long long> m_buckets[HISTOGRAM_COUNT][HISTOGRAM_BUCKETS];
+	std::atomic<unsigned long long> m_sums[HISTOGRAM_COUNT];
+};
+
+static CThreadSlots<CThreadMetrics, MAX_METRIC_THREADS> m_threads;
+
+static std::atomic<long long> m_gauges[GAUGE_COUNT];
+
+// Only this thread writes to its own values, so a plain store will do
+static void add(std::atomic<unsigned long long>& value, unsigned long long n)
+{
+	if (m_threads.isShared())
+		value.fetch_add(n, std::memory_order_relaxed);
+	else
+		value.store(value.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+}
+
+void CMetrics::increment(METRIC metric, unsigned long long n)
+{
+	assert((unsigned int)metric < METRIC_COUNT);
+
+	add(m_threads.get().m_counters[(unsigned int)metric], n);
+}
+
+void CMetrics::observe(HISTOGRAM histogram, unsigned long long value)
+{
+	assert((unsigned int)histogram < HISTOGRAM_COUNT);
+
+	unsigned int bucket = 0U;
+	while (bucket < (HISTOGRAM_BUCKETS - 1U) && value > BOUNDS[bucket])
+		bucket++;
+
+	CThreadMetrics& metrics = m_threads.get();
+	add(metrics.m_buckets[(unsigned int)histogram][bucket], 1ULL);
+	add(metrics.m_sums[(unsigned int)histogram], value);
+}
+
+void CMetrics::set(GAUGE gauge, long long value)
+{
+	assert((unsigned int)gauge < GAUGE_COUNT);
+
+	m_gauges[(unsigned int)gauge].store(value, std::memory_order_relaxed);
+}
+
+unsigned long long CMetrics::get(METRIC metric)
+{
+	assert((unsigned int)metric < METRIC_COUNT);
+
+	unsigned long long total = 0ULL;
+
+	unsigned int count = m_threads.getCount();
+	for (unsigned int i = 0U; i < count; i++)
+		total += m_threads[i].m_counters[(unsigned int)metric].load(std::memory_order_relaxed);
+
+	return total;
+}
+
+long long CMetrics::get(GAUGE gauge)
+{
+	assert((unsigned int)gauge < GAUGE_COUNT);
+
+	return m_gauges[(unsigned int)gauge].load(std::memory_order_relaxed);
+}
+
+void CMetrics::get(HISTOGRAM histogram, unsigned long long* buckets, unsigned long long& count, unsigned long long& sum)
+{
+	assert((unsigned int)histogram < HISTOGRAM_COUNT);
+	assert(buckets != nullptr);
+
+	count = 0ULL;
+	sum   = 0ULL;
+
+	for (unsigned int j = 0U; j < HISTOGRAM_BUCKETS; j++)
+		buckets[j] = 0ULL;
+
+	unsigned int threads = m_threads.getCount();
+	for (unsigned int i = 0U; i < threads; i++) {
+		for (unsigned int j = 0U; j < HISTOGRAM_BUCKETS; j++) {
+			unsigned long long n = m_threads[i].m_buckets[(unsigned int)histogram][j].load(std::memory_order_relaxed);
+			buckets[j] += n;
+			count      += n;
+		}
+
+		sum += m_threads[i].m_sums[(unsigned int)histogram].load(std::memory_order_relaxed);
+	}
+}
+
+unsigned long long CMetrics::getBound(unsigned int bucket)
+{
+	assert(bucket < HISTOGRAM_BUCKETS);
+
+	return BOUNDS[bucket];
+}
+
+const char* CMetrics::getName(METRIC metric)
+{
+	return METRIC_NAMES[(unsigned int)metric];
+}
+
+const char* CMetrics::getName(GAUGE gauge)
+{
+	return GAUGE_NAMES[(unsigned int)gauge];
+}
+
+const char* CMetrics::getName(HISTOGRAM histogram)
+{
+	return HISTOGRAM_NAMES[(unsigned int)histogram];
+}
+
+const char* CMetrics::getHelp(METRIC metric)
+{
+	return METRIC_HELP[(unsigned int)metric];
+}
+
+const char* CMetrics::getHelp(GAUGE gauge)
+{
+	return GAUGE_HELP[(unsigned int)gauge];
+}
+
+const char* CMetrics::getHelp(HISTOGRAM histogram)
+{
+	return HISTOGRAM_HELP[(unsigned int)histogram];
+}
@@ -0,0 +1,97 @@
+/*
+ *   Copyright (C) 2026 by Jonathan Naylor G4KLX
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program; if not, write to the Free Software
+ *   Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+#if !defined(Metrics_H)
+#define	Metrics_H
+
+enum class METRIC : unsigned int {
+	FRAMES_IN,
+	FRAMES_OUT,
+	DROPPED_INVALID,
+	DROPPED_DUPLICATE,
+	DROPPED_OVER_SHARE,
+	DROPPED_QUEUE_FULL,
+	DROPPED_DISCARDED,
+	BYTES_SENT,
+	BYTES_RECEIVED,
+	CONNECTS,
+	CONNECT_FAILURES,
+	MQTT_PUBLISH_FAILURES,
+	TCP_RETRANSMITS,
+	SEND_QUEUE_STALLS
+};
+
+const unsigned int METRIC_COUNT = 14U;
+
+enum class GAUGE : unsigned int {
+	QUEUE_DEPTH,
+	APRS_CONNECTED,
+	APRS_ENABLED,
+	MQTT_CONNECTED,
+	TCP_RTT,
+	TCP_RTT_VAR,
+	TCP_CWND,
+	TCP_UNACKED,
+	TCP_SEND_QUEUE,
+	TCP_UNSENT
+};
+
+const unsigned int GAUGE_COUNT = 10U;
+
+enum class HISTOGRAM : unsigned int {
+	CONNECT_TIME,
+	QUEUE_TIME
+};
+
+const unsigned int HISTOGRAM_COUNT = 2U;
+
+// The upper bounds of the histogram buckets, the last is for everything larger
+const unsigned int HISTOGRAM_BUCKETS = 14U;
+
+// The counters and histograms are kept separately by each thread that
+// updates them, so no thread waits for another or shares a cache line with
+// it. Reading them adds up the values from every thread. The gauges are set
+// by whoever samples them.
+class CMetrics {
+public:
+	static void increment(METRIC metric, unsigned long long n = 1ULL);
+
+	// The value is in microseconds
+	static void observe(HISTOGRAM histogram, unsigned long long value);
+
+	static void set(GAUGE gauge, long long value);
+
+	static unsigned long long get(METRIC metric);
+	static long long          get(GAUGE gauge);
+
+	// The counts are per bucket, not cumulative
+	static void get(HISTOGRAM histogram, unsigned long long* buckets, unsigned long long& count, unsigned long long& sum);
+
+	// In microseconds, zero for the last bucket
+	static unsigned long long getBound(unsigned int bucket);
+
+	static const char* getName(METRIC metric);
+	static const char* getName(GAUGE gauge);
+	static const char* getName(HISTOGRAM histogram);
+
+	static const char* getHelp(METRIC metric);
+	static const char* getHelp(GAUGE gauge);
+	static const char* getHelp(HISTOGRAM histogram);
+};
+
+#endif
@@ -0,0 +1,449 @@
+/*
+ *   Copyright (C) 2026 by Jonathan Naylor G4KLX
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program; if not, write to the Free Software
+ *   Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+#include "MetricsServerThread.h"
+#include "StopWatch.h"
+#include "Latency.h"
+#include "Metrics.h"
+#include "Log.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cstdio>
+#include <cstring>
+
+#if !defined(_WIN32) && !defined(_WIN64)
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netdb.h>
+#include <unistd.h>
+#include <poll.h>
+#include <errno.h>
+#endif
+
+// Scrapers are few, anyone else has to wait their turn
+const unsigned int MAX_CLIENTS = 8U;
+
+const unsigned int MAX_REQUEST = 4096U;
+
+// Microseconds for a client to send its request and take the reply
+const unsigned long long CLIENT_TIMEOUT = 5000000ULL;
+
+const int POLL_TIME = 500;
+
+CMetricsServerThread::CMetricsServerThread(const std::string& address, unsigned short port) :
+CThread(),
+m_address(address),
+m_port(port),
+m_listenFd(-1),
+m_exit(false),
+m_clients(),
+m_requests(0U)
+{
+}
+
+CMetricsServerThread::~CMetricsServerThread()
+{
+}
+
+unsigned int CMetricsServerThread::getRequests() const
+{
+	return m_requests;
+}
+
+void CMetricsServerThread::writeMetrics(std::string& body)
+{
+	char buffer[200U];
+
+	for (unsigned int i = 0U; i < METRIC_COUNT; i++) {
+		const char* name = CMetrics::getName(METRIC(i));
+
+		::snprintf(buffer, sizeof(buffer), "# HELP aprsgateway_%s_total %s\n# TYPE aprsgateway_%s_total counter\n", name, CMetrics::getHelp(METRIC(i)), name);
+		body += buffer;
+
+		::snprintf(buffer, sizeof(buffer), "aprsgateway_%s_total %llu\n", name, CMetrics::get(METRIC(i)));
+		body += buffer;
+	}
+
+	for (unsigned int i = 0U; i < GAUGE_COUNT; i++) {
+		const char* name = CMetrics::getName(GAUGE(i));
+
+		::snprintf(buffer, sizeof(buffer), "# HELP aprsgateway_%s %s\n# TYPE aprsgateway_%s gauge\n", name, CMetrics::getHelp(GAUGE(i)), name);
+		body += buffer;
+
+		::snprintf(buffer, sizeof(buffer), "aprsgateway_%s %lld\n", name, CMetrics::get(GAUGE(i)));
+		body += buffer;
+	}
+
+	// Prometheus wants the buckets cumulative and the times in seconds
+	for (unsigned int i = 0U; i < HISTOGRAM_COUNT; i++) {
+		const char* name = CMetrics::getName(HISTOGRAM(i));
+
+		::snprintf(buffer, sizeof(buffer), "# HELP aprsgateway_%s_seconds %s\n# TYPE aprsgateway_%s_seconds histogram\n", name, CMetrics::getHelp(HISTOGRAM(i)), name);
+		body += buffer;
+
+		unsigned long long buckets[HISTOGRAM_BUCKETS];
+		unsigned long long count, sum;
+		CMetrics::get(HISTOGRAM(i), buckets, count, sum);
+
+		unsigned long long total = 0ULL;
+		for (unsigned int j = 0U; j < HISTOGRAM_BUCKETS; j++) {
+			total += buckets[j];
+
+			unsigned long long bound = CMetrics::getBound(j);
+			if (bound > 0ULL)
+				::snprintf(buffer, sizeof(buffer), "aprsgateway_%s_seconds_bucket{le=\"%g\"} %llu\n", name, double(bound) / 1000000.0, total);
+			else
+				::snprintf(buffer, sizeof(buffer), "aprsgateway_%s_seconds_bucket{le=\"+Inf\"} %llu\n", name, total);
+			body += buffer;
+		}
+
+		::snprintf(buffer, sizeof(buffer), "aprsgateway_%s_seconds_sum %.6f\naprsgateway_%s_seconds_count %llu\n", name, double(sum) / 1000000.0, name, count);
+		body += buffer;
+	}
+
+	// The stage percentiles as one summary, labelled by stage
+	body += "# HELP aprsgateway_frame_latency_seconds Time taken by each stage of a frame's journey\n# TYPE aprsgateway_frame_latency_seconds summary\n";
+
+	static const double QUANTILES[] = { 50.0, 99.0, 99.9 };
+
+	for (unsigned int i = 0U; i < LATENCY_COUNT; i++) {
+		LATENCY stage = LATENCY(i);
+		const char* name = CLatency::getName(stage);
+
+		for (unsigned int j = 0U; j < 3U; j++) {
+			::snprintf(buffer, sizeof(buffer), "aprsgateway_frame_latency_seconds{stage=\"%s\",quantile=\"%g\"} %.6f\n", name, QUANTILES[j] / 100.0, double(CLatency::getPercentile(stage, QUANTILES[j])) / 1000000.0);
+			body += buffer;
+		}
+
+		::snprintf(buffer, sizeof(buffer), "aprsgateway_frame_latency_seconds_sum{stage=\"%s\"} %.6f\naprsgateway_frame_latency_seconds_count{stage=\"%s\"} %llu\n", name, double(CLatency::getSum(stage)) / 1000000.0, name, CLatency::getCount(stage));
+		body += buffer;
+	}
+}
+
+// A standby in an election isn't meant to be connected to APRS-IS
+bool CMetricsServerThread::isHealthy(std::string& body)
+{
+	bool aprs    = CMetrics::get(GAUGE::APRS_CONNECTED) == 1LL;
+	bool enabled = CMetrics::get(GAUGE::APRS_ENABLED) == 1LL;
+	bool mqtt    = CMetrics::get(GAUGE::MQTT_CONNECTED) == 1LL;
+
+	body += "aprs-is: ";
+	body += aprs ? "connected\n" : (enabled ? "disconnected\n" : "standby\n");
+	body += "mqtt: ";
+	body += mqtt ? "connected\n" : "disconnected\n";
+
+	return mqtt && (aprs || !enabled);
+}
+
+void CMetricsServerThread::respond(CClient* client)
+{
+	assert(client != nullptr);
+
+	m_requests++;
+
+	// Only the request line matters, "GET /path HTTP/1.x"
+	std::string::size_type end = client->m_request.find_first_of("\r\n");
+	std::string line = client->m_request.substr(0U, end);
+
+	std::string method, path;
+	std::string::size_type space1 = line.find(' ');
+	if (space1 != std::string::npos) {
+		method = line.substr(0U, space1);
+
+		std::string::size_type space2 = line.find(' ', space1 + 1U);
+		path = line.substr(space1 + 1U, space2 == std::string::npos ? std::string::npos : space2 - space1 - 1U);
+
+		std::string::size_type query = path.find('?');
+		if (query != std::string::npos)
+			path.erase(query);
+	}
+
+	const char* status;
+	const char* type = "text/plain; charset=utf-8";
+	std::string body;
+
+	if (method != "GET" && method != "HEAD") {
+		status = "405 Method Not Allowed";
+		body   = "method not allowed\n";
+	} else if (path == "/metrics") {
+		status = "200 OK";
+		type   = "text/plain; version=0.0.4; charset=utf-8";
+		body.reserve(8192U);
+		writeMetrics(body);
+	} else if (path == "/healthz") {
+		status = isHealthy(body) ? "200 OK" : "503 Service Unavailable";
+	} else {
+		status = "404 Not Found";
+		body   = "not found\n";
+	}
+
+	char header[200U];
+	::snprintf(header, sizeof(header), "HTTP/1.0 %s\r\nContent-Type: %s\r\nContent-Length: %u\r\nConnection: close\r\n\r\n", status, type, (unsigned int)body.size());
+
+	client->m_response = header;
+	if (method != "HEAD")
+		client->m_response += body;
+	client->m_sent = 0U;
+}
+
+#if !defined(_WIN32) && !defined(_WIN64)
+
+bool CMetricsServerThread::start()
+{
+	char port[10U];
+	::sprintf(port, "%u", m_port);
+
+	struct addrinfo hints;
+	::memset(&hints, 0x00, sizeof(hints));
+	hints.ai_family   = AF_UNSPEC;
+	hints.ai_socktype = SOCK_STREAM;
+	hints.ai_flags    = AI_PASSIVE | AI_NUMERICSERV;
+
+	struct addrinfo* res = nullptr;
+	int err = ::getaddrinfo(m_address.empty() ? nullptr : m_address.c_str(), port, &hints, &res);
+	if (err != 0) {
+		LogError("Cannot find address for the metrics server %s, err=%d", m_address.c_str(), err);
+		return false;
+	}
+
+	m_listenFd = ::socket(res->ai_family, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+	if (m_listenFd < 0) {
+		LogError("Cannot create the metrics server socket, err=%d", errno);
+		::freeaddrinfo(res);
+		return false;
+	}
+
+	int reuse = 1;
+	::setsockopt(m_listenFd, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+
+	if (::bind(m_listenFd, res->ai_addr, res->ai_addrlen) < 0) {
+		LogError("Cannot bind the metrics server to port %u, err=%d", m_port, errno);
+		::freeaddrinfo(res);
+		::close(m_listenFd);
+		m_listenFd = -1;
+		return false;
+	}
+
+	::freeaddrinfo(res);
+
+	if (::listen(m_listenFd, SOMAXCONN) < 0) {
+		LogError("Cannot listen on the metrics server socket, err=%d", errno);
+		::close(m_listenFd);
+		m_listenFd = -1;
+		return false;
+	}
+
+	LogMessage("Metrics server listening on port %u", m_port);
+
+	run();
+
+	return true;
+}
+
+void CMetricsServerThread::entry()
+{
+	LogMessage("Starting the metrics server thread");
+
+	struct pollfd fds[MAX_CLIENTS + 1U];
+
+	while (!m_exit) {
+		unsigned int n = 0U;
+
+		if (m_clients.size() < MAX_CLIENTS) {
+			fds[n].fd      = m_listenFd;
+			fds[n].events  = POLLIN;
+			fds[n].revents = 0;
+			n++;
+		}
+
+		for (std::vector<CClient*>::const_iterator it = m_clients.begin(); it != m_clients.end(); ++it) {
+			fds[n].fd      = (*it)->m_fd;
+			fds[n].events  = (*it)->m_response.empty() ? POLLIN : POLLOUT;
+			fds[n].revents = 0;
+			n++;
+		}
+
+		int ret = ::poll(fds, n, POLL_TIME);
+		if (ret < 0 && errno != EINTR) {
+			LogError("Error from poll in the metrics server, err=%d", errno);
+			break;
+		}
+
+		unsigned long long now = CStopWatch::getMicroseconds();
+
+		// Clients are only closed here, so the file descriptors still line up
+		std::vector<CClient*> finished;
+
+		for (unsigned int i = 0U; i < n; i++) {
+			if (fds[i].fd == m_listenFd) {
+				if ((fds[i].revents & POLLIN) != 0)
+					accept();
+				continue;
+			}
+
+			CClient* client = nullptr;
+			for (std::vector<CClient*>::const_iterator it = m_clients.begin(); it != m_clients.end(); ++it) {
+				if ((*it)->m_fd == fds[i].fd) {
+					client = *it;
+					break;
+				}
+			}
+
+			if (client == nullptr)
+				continue;
+
+			bool done = false;
+			if ((fds[i].revents & (POLLERR | POLLHUP | POLLNVAL)) != 0)
+				done = true;
+			else if ((fds[i].revents & POLLIN) != 0)
+				done = !read(client);
+			else if ((fds[i].revents & POLLOUT) != 0)
+				done = !write(client);
+
+			if (!done && (now - client->m_start) > CLIENT_TIMEOUT)
+				done = true;
+
+			if (done)
+				finished.push_back(client);
+		}
+
+		for (std::vector<CClient*>::const_iterator it = finished.begin(); it != finished.end(); ++it)
+			close(*it);
+	}
+
+	while (!m_clients.empty())
+		close(m_clients.front());
+
+	::close(m_listenFd);
+	m_listenFd = -1;
+
+	LogMessage("Stopping the metrics server thread");
+}
+
+void CMetricsServerThread::stop()
+{
+	m_exit = true;
+
+	wait();
+}
+
+void CMetricsServerThread::accept()
+{
+	while (m_clients.size() < MAX_CLIENTS) {
+		int fd = ::accept4(m_listenFd, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+		if (fd < 0) {
+			if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)
+				LogError("Error accepting a metrics server client, err=%d", errno);
+			return;
+		}
+
+		CClient* client = new CClient;
+		client->m_fd    = fd;
+		client->m_sent  = 0U;
+		client->m_start = CStopWatch::getMicroseconds();
+
+		m_clients.push_back(client);
+	}
+}
+
+// Returns false when the client is finished with
+bool CMetricsServerThread::read(CClient* client)
+{
+	assert(client != nullptr);
+
+	char buffer[1024U];
+	ssize_t len = ::recv(client->m_fd, buffer, sizeof(buffer), 0);
+	if (len < 0)
+		return errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR;
+	if (len == 0)
+		return false;
+
+	client->m_request.append(buffer, len);
+
+	// Wait for the whole header, bodies are ignored
+	if (client->m_request.find("\r\n\r\n") == std::string::npos && client->m_request.find("\n\n") == std::string::npos)
+		return client->m_request.size() < MAX_REQUEST;
+
+	respond(client);
+
+	return write(client);
+}
+
+bool CMetricsServerThread::write(CClient* client)
+{
+	assert(client != nullptr);
+
+	while (client->m_sent < client->m_response.size()) {
+		ssize_t len = ::send(client->m_fd, client->m_response.data() + client->m_sent, client->m_response.size() - client->m_sent, MSG_NOSIGNAL);
+		if (len < 0)
+			return errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR;
+
+		client->m_sent += (unsigned int)len;
+	}
+
+	return false;
+}
+
+void CMetricsServerThread::close(CClient* client)
+{
+	assert(client != nullptr);
+
+	::close(client->m_fd);
+
+	m_clients.erase(std::remove(m_clients.begin(), m_clients.end(), client), m_clients.end());
+
+	delete client;
+}
+
+#else
+
+bool CMetricsServerThread::start()
+{
+	LogError("The metrics server is not available on Windows");
+
+	return false;
+}
+
+void CMetricsServerThread::entry()
+{
+}
+
+void CMetricsServerThread::stop()
+{
+}
+
+void CMetricsServerThread::accept()
+{
+}
+
+bool CMetricsServerThread::read(CClient*)
+{
+	return false;
+}
+
+bool CMetricsServerThread::write(CClient*)
+{
+	return false;
+}
+
+void CMetricsServerThread::close(CClient*)
+{
+}
+
+#endif
@@ -0,0 +1,70 @@
+/*
+ *   Copyright (C) 2026 by Jonathan Naylor G4KLX
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program; if not, write to the Free Software
+ *   Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+#if !defined(MetricsServerThread_H)
+#define	MetricsServerThread_H
+
+#include "Thread.h"
+
+#include <string>
+#include <vector>
+
+// A small HTTP server for monitoring. It answers /metrics with the counters,
+// gauges and histograms in the Prometheus text format, and /healthz with
+// whether the links to APRS-IS and MQTT are up. It runs in its own thread so
+// a slow scraper never holds up the frames.
+class CMetricsServerThread : public CThread {
+public:
+	CMetricsServerThread(const std::string& address, unsigned short port);
+	virtual ~CMetricsServerThread();
+
+	bool start();
+
+	virtual void entry();
+
+	void stop();
+
+	unsigned int getRequests() const;
+
+private:
+	struct CClient {
+		int                m_fd;
+		std::string        m_request;
+		std::string        m_response;
+		unsigned int       m_sent;
+		unsigned long long m_start;
+	};
+
+	std::string           m_address;
+	unsigned short        m_port;
+	int                   m_listenFd;
+	bool                  m_exit;
+	std::vector<CClient*> m_clients;
+	unsigned int          m_requests;
+
+	void accept();
+	bool read(CClient* client);
+	bool write(CClient* client);
+	void close(CClient* client);
+
+	void respond(CClient* client);
+	static void writeMetrics(std::string& body);
+	static bool isHealthy(std::string& body);
+};
+
+#endif
@@ -0,0 +1,166 @@
+/*
+ *   Copyright (C) 2026 by Jonathan Naylor G4KLX
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program; if not, write to the Free Software
+ *   Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+#include "Profile.h"
+
+#if defined(PROFILING)
+
+#include "ThreadSlots.h"
+#include "StopWatch.h"
+#include "Log.h"
+
+#include <atomic>
+#include <cassert>
+#include <cstdio>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define	HAS_TSC
+#elif defined(_M_X64) || defined(_M_IX86)
+#include <intrin.h>
+#define	HAS_TSC
+#elif !defined(_WIN32) && !defined(_WIN64)
+#include <time.h>
+#else
+#include <chrono>
+#endif
+
+// Sets of zone timings, see CThreadSlots
+const unsigned int MAX_PROFILE_THREADS = 32U;
+
+static const char* NAMES[ZONE_COUNT] = {
+	"onAPRS", "enqueue", "dequeue", "send", "readLines", "log", "json"
+};
+
+struct alignas(64) CThreadProfile {
+	std::atomic<const char*>        m_name;
+	std::atomic<unsigned long long> m_calls[ZONE_COUNT];
+	std::atomic<unsigned long long> m_ticks[ZONE_COUNT];
+	std::atomic<unsigned long long> m_max[ZONE_COUNT];
+
+	// Only used by the report
+	unsigned long long m_lastCalls[ZONE_COUNT];
+	unsigned long long m_lastTicks[ZONE_COUNT];
+};
+
+static CThreadSlots<CThreadProfile, MAX_PROFILE_THREADS> m_threads;
+
+// For working out the rate of the time stamp counter, and the report interval
+static const unsigned long long m_startTicks = CProfile::getTicks();
+static const unsigned long long m_startTime  = CStopWatch::getMicroseconds();
+static unsigned long long m_lastTicks = m_startTicks;
+
+void CProfile::setThreadName(const char* name)
+{
+	assert(name != nullptr);
+
+	CThreadProfile& profile = m_threads.get();
+	if (!m_threads.isShared())
+		profile.m_name.store(name, std::memory_order_relaxed);
+}
+
+unsigned long long CProfile::getTicks()
+{
+#if defined(HAS_TSC)
+	return __rdtsc();
+#elif !defined(_WIN32) && !defined(_WIN64)
+	struct timespec ts;
+	::clock_gettime(CLOCK_MONOTONIC_RAW, &ts);
+
+	return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+#else
+	return (unsigned long long)std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+}
+
+void CProfile::add(ZONE zone, unsigned long long ticks)
+{
+	assert((unsigned int)zone < ZONE_COUNT);
+
+	CThreadProfile& profile = m_threads.get();
+
+	// Only this thread writes to its own values, so a plain store will do
+	if (m_threads.isShared()) {
+		profile.m_calls[(unsigned int)zone].fetch_add(1ULL, std::memory_order_relaxed);
+		profile.m_ticks[(unsigned int)zone].fetch_add(ticks, std::memory_order_relaxed);
+	} else {
+		std::atomic<unsigned long long>& calls = profile.m_calls[(unsigned int)zone];
+		calls.store(calls.load(std::memory_order_relaxed) + 1ULL, std::memory_order_relaxed);
+
+		std::atomic<unsigned long long>& total = profile.m_ticks[(unsigned int)zone];
+		total.store(total.load(std::memory_order_relaxed) + ticks, std::memory_order_relaxed);
+	}
+
+	std::atomic<unsigned long long>& max = profile.m_max[(unsigned int)zone];
+	if (ticks > max.load(std::memory_order_relaxed))
+		max.store(ticks, std::memory_order_relaxed);
+}
+
+void CProfile::report()
+{
+	unsigned long long ticks = getTicks();
+	unsigned long long time  = CStopWatch::getMicroseconds();
+
+	if (time <= m_startTime || ticks <= m_startTicks)
+		return;
+
+	// Ticks a microsecond, nanoseconds unless there is a time stamp counter
+	double rate = double(ticks - m_startTicks) / double(time - m_startTime);
+
+	double interval = double(ticks - m_lastTicks);
+	m_lastTicks = ticks;
+
+	unsigned int count = m_threads.getCount();
+	for (unsigned int i = 0U; i < count; i++) {
+		CThreadProfile& profile = m_threads[i];
+
+		char number[20U];
+		const char* name = profile.m_name.load(std::memory_order_relaxed);
+		if (name == nullptr) {
+			::sprintf(number, "thread %u", i + 1U);
+			name = number;
+		}
+
+		for (unsigned int j = 0U; j < ZONE_COUNT; j++) {
+			unsigned long long calls = profile.m_calls[j].load(std::memory_order_relaxed);
+			unsigned long long total = profile.m_ticks[j].load(std::memory_order_relaxed);
+			unsigned long long max   = profile.m_max[j].exchange(0ULL, std::memory_order_relaxed);
+
+			unsigned long long newCalls = calls - profile.m_lastCalls[j];
+			unsigned long long newTicks = total - profile.m_lastTicks[j];
+
+			profile.m_lastCalls[j] = calls;
+			profile.m_lastTicks[j] = total;
+
+			if (newCalls == 0ULL)
+				continue;
+
+			LogMessage("Profile %s, %s: %llu calls, %.3f ms, %.2f%% of the time, mean: %.2f us, max: %.2f us", name, NAMES[j], newCalls,
+				double(newTicks) / rate / 1000.0, (100.0 * double(newTicks)) / interval, double(newTicks) / rate / double(newCalls), double(max) / rate);
+		}
+	}
+}
+
+const char* CProfile::getName(ZONE zone)
+{
+	assert((unsigned int)zone < ZONE_COUNT);
+
+	return NAMES[(unsigned int)zone];
+}
+
+#endif
@@ -0,0 +1,87 @@
+/*
+ *   Copyright (C) 2026 by Jonathan Naylor G4KLX
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program; if not, write to the Free Software
+ *   Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+#if !defined(Profile_H)
+#define	Profile_H
+
+// Build with "make PROFILE=1" to time the zones below, otherwise they
+// compile to nothing.
+
+enum class ZONE : unsigned int {
+	ON_APRS,		// A frame from MQTT, up to it being queued
+	ENQUEUE,		// Copying a frame into the queue
+	DEQUEUE,		// Gathering frames from the queue for a write
+	SEND,			// Writing frames to APRS-IS
+	READ_LINES,		// Splitting up the lines from APRS-IS
+	LOG,			// Formatting and queueing a log record
+	JSON			// Serialising and publishing JSON
+};
+
+const unsigned int ZONE_COUNT = 7U;
+
+#if defined(PROFILING)
+
+// The times are kept by each thread in cycles where the CPU has a time
+// stamp counter, and converted when reported. Zones may be nested, the
+// time of the inner zone is included in the outer one.
+class CProfile {
+public:
+	// Names the calling thread in the report
+	static void setThreadName(const char* name);
+
+	static unsigned long long getTicks();
+
+	static void add(ZONE zone, unsigned long long ticks);
+
+	// Logs where each thread has spent its time since the last report
+	static void report();
+
+	static const char* getName(ZONE zone);
+};
+
+class CProfileZone {
+public:
+	CProfileZone(ZONE zone) :
+	m_zone(zone),
+	m_start(CProfile::getTicks())
+	{
+	}
+
+	~CProfileZone()
+	{
+		CProfile::add(m_zone, CProfile::getTicks() - m_start);
+	}
+
+private:
+	ZONE               m_zone;
+	unsigned long long m_start;
+};
+
+#define	PROFILE_JOIN2(a, b)		a##b
+#define	PROFILE_JOIN(a, b)		PROFILE_JOIN2(a, b)
+#define	PROFILE_ZONE(zone)		CProfileZone PROFILE_JOIN(profileZone, __LINE__)(zone)
+#define	PROFILE_THREAD(name)	CProfile::setThreadName(name)
+
+#else
+
+#define	PROFILE_ZONE(zone)
+#define	PROFILE_THREAD(name)
+
+#endif
+
+#endif
@@ -21,10 +21,12 @@
 
 #include "Log.h"
 
+#include <atomic>
 #include <cstdio>
 #include <cassert>
 #include <cstring>
 
+// Safe for one thread adding data while another takes it out
 template<class T> class CRingBuffer {
 public:
 	CRingBuffer(unsigned int length, const char* name) :
@@ -54,16 +56,39 @@ public:
 			return false;
 		}
 
-		for (unsigned int i = 0U; i < nSamples; i++) {
-			m_buffer[m_iPtr++] = buffer[i];
+		putData(0U, buffer, nSamples);
 
-			if (m_iPtr == m_length)
-				m_iPtr = 0U;
-		}
+		commit(nSamples);
 
 		return true;
 	}
 
+	// Copies data into the free space, offset samples beyond the end of the
+	// existing data. It is not visible to the reader until committed.
+	void putData(unsigned int offset, const T* buffer, unsigned int nSamples)
+	{
+		unsigned int ptr = m_iPtr.load(std::memory_order_relaxed) + offset;
+		if (ptr >= m_length)
+			ptr -= m_length;
+
+		// Copy in at most two blocks, either side of the end of the buffer
+		unsigned int first = m_length - ptr;
+		if (first > nSamples)
+			first = nSamples;
+
+		::memcpy(m_buffer + ptr, buffer, first * sizeof(T));
+		::memcpy(m_buffer, buffer + first, (nSamples - first) * sizeof(T));
+	}
+
+	void commit(unsigned int nSamples)
+	{
+		unsigned int ptr = m_iPtr.load(std::memory_order_relaxed) + nSamples;
+		if (ptr >= m_length)
+			ptr -= m_length;
+
+		m_iPtr.store(ptr, std::memory_order_release);
+	}
+
 	bool getData(T* buffer, unsigned int nSamples)
 	{
 		if (dataSize() < nSamples) {
@@ -71,12 +96,9 @@ public:
 			return false;
 		}
 
-		for (unsigned int i = 0U; i < nSamples; i++) {
-			buffer[i] = m_buffer[m_oPtr++];
+		copyOut(buffer, nSamples);
 
-			if (m_oPtr == m_length)
-				m_oPtr = 0U;
-		}
+		release(nSamples);
 
 		return true;
 	}
@@ -88,14 +110,45 @@ public:
 			return false;
 		}
 
-		unsigned int ptr = m_oPtr;
-		for (unsigned int i = 0U; i < nSamples; i++) {
-			buffer[i] = m_buffer[ptr++];
+		copyOut(buffer, nSamples);
+
+		return true;
+	}
+
+	// Gives direct access to data in the buffer, starting offset samples in.
+	// The data may be split in two by the end of the buffer, if not then
+	// length2 is zero. The data stays in the buffer until skipped.
+	bool getData(unsigned int offset, unsigned int nSamples, const T*& buffer1, unsigned int& length1, const T*& buffer2, unsigned int& length2) const
+	{
+		if (dataSize() < (offset + nSamples)) {
+			LogError("**** Underflow direct read in %s ring buffer, %u < %u", m_name, dataSize(), offset + nSamples);
+			return false;
+		}
+
+		unsigned int ptr = m_oPtr.load(std::memory_order_relaxed) + offset;
+		if (ptr >= m_length)
+			ptr -= m_length;
 
-			if (ptr == m_length)
-				ptr = 0U;
+		length1 = m_length - ptr;
+		if (length1 > nSamples)
+			length1 = nSamples;
+		buffer1 = m_buffer + ptr;
+
+		length2 = nSamples - length1;
+		buffer2 = m_buffer;
+
+		return true;
+	}
+
+	bool skip(unsigned int nSamples)
+	{
+		if (dataSize() < nSamples) {
+			LogError("**** Underflow skip in %s ring buffer, %u < %u", m_name, dataSize(), nSamples);
+			return false;
 		}
 
+		release(nSamples);
+
 		return true;
 	}
 
@@ -109,13 +162,16 @@ public:
 
 	unsigned int freeSpace() const
 	{
-		if (m_oPtr == m_iPtr)
+		unsigned int iPtr = m_iPtr.load(std::memory_order_acquire);
+		unsigned int oPtr = m_oPtr.load(std::memory_order_acquire);
+
+		if (oPtr == iPtr)
 			return m_length;
 
-		if (m_oPtr > m_iPtr)
-			return m_oPtr - m_iPtr;
+		if (oPtr > iPtr)
+			return oPtr - iPtr;
 
-		return (m_length + m_oPtr) - m_iPtr;
+		return (m_length + oPtr) - iPtr;
 	}
 
 	unsigned int dataSize() const
@@ -130,20 +186,41 @@ public:
 
 	bool hasData() const
 	{
-		return m_oPtr != m_iPtr;
+		return m_oPtr.load(std::memory_order_acquire) != m_iPtr.load(std::memory_order_acquire);
 	}
 
 	bool isEmpty() const
 	{
-		return m_oPtr == m_iPtr;
+		return m_oPtr.load(std::memory_order_acquire) == m_iPtr.load(std::memory_order_acquire);
 	}
 
 private:
-	unsigned int m_length;
-	const char*  m_name;
-	T*           m_buffer;
-	unsigned int m_iPtr;
-	unsigned int m_oPtr;
+	unsigned int              m_length;
+	const char*               m_name;
+	T*                        m_buffer;
+	std::atomic<unsigned int> m_iPtr;
+	std::atomic<unsigned int> m_oPtr;
+
+	void copyOut(T* buffer, unsigned int nSamples) const
+	{
+		unsigned int ptr = m_oPtr.load(std::memory_order_relaxed);
+
+		unsigned int first = m_length - ptr;
+		if (first > nSamples)
+			first = nSamples;
+
+		::memcpy(buffer, m_buffer + ptr, first * sizeof(T));
+		::memcpy(buffer + first, m_buffer, (nSamples - first) * sizeof(T));
+	}
+
+	void release(unsigned int nSamples)
+	{
+		unsigned int ptr = m_oPtr.load(std::memory_order_relaxed) + nSamples;
+		if (ptr >= m_length)
+			ptr -= m_length;
+
+		m_oPtr.store(ptr, std::memory_order_release);
+	}
 };
 
 #endif
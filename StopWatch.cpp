@@ -60,6 +60,17 @@ unsigned int CStopWatch::elapsed()
 	return (unsigned int)(temp.QuadPart / m_frequencyS.QuadPart);
 }
 
+unsigned long long CStopWatch::getMicroseconds()
+{
+	LARGE_INTEGER frequency;
+	::QueryPerformanceFrequency(&frequency);
+
+	LARGE_INTEGER now;
+	::QueryPerformanceCounter(&now);
+
+	return (unsigned long long)((now.QuadPart / frequency.QuadPart) * 1000000ULL + ((now.QuadPart % frequency.QuadPart) * 1000000ULL) / frequency.QuadPart);
+}
+
 #else
 
 #include <cstdio>
@@ -102,4 +113,12 @@ unsigned int CStopWatch::elapsed()
 	return nowMS - m_startMS;
 }
 
+unsigned long long CStopWatch::getMicroseconds()
+{
+	struct timespec now;
+	::clock_gettime(CLOCK_MONOTONIC, &now);
+
+	return now.tv_sec * 1000000ULL + now.tv_nsec / 1000ULL;
+}
+
 #endif
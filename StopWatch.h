@@ -37,6 +37,9 @@ public:
 	unsigned long long start();
 	unsigned int       elapsed();
 
+	// A monotonic clock in microseconds, for measuring short intervals
+	static unsigned long long getMicroseconds();
+
 private:
 #if defined(_WIN32) || defined(_WIN64)
 	LARGE_INTEGER  m_frequencyS;
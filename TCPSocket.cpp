@@ -17,6 +17,7 @@
  */
 
 #include "TCPSocket.h"
+#include "Profile.h"
 #include "Log.h"
 
 #include <cstdio>
@@ -27,6 +28,8 @@
 typedef int ssize_t;
 #else
 #include <cerrno>
+#include <sys/ioctl.h>
+#include <linux/sockios.h>
 #endif
 
 CTCPSocket::CTCPSocket(const std::string& address, unsigned int port) :
@@ -244,6 +247,8 @@ bool CTCPSocket::write(const unsigned char* buffer, unsigned int length)
 	assert(m_fd != -1);
 #endif
 
+	PROFILE_ZONE(ZONE::SEND);
+
 	ssize_t ret = ::send(m_fd, (char *)buffer, length, 0);
 	if (ret != ssize_t(length)) {
 #if defined(_WIN32) || defined(_WIN64)
@@ -257,6 +262,57 @@ bool CTCPSocket::write(const unsigned char* buffer, unsigned int length)
 	return true;
 }
 
+bool CTCPSocket::write(const TCPBuffer* buffers, unsigned int count)
+{
+	assert(buffers != nullptr);
+	assert(count > 0U && count <= TCP_MAX_BUFFERS);
+#if defined(_WIN32) || defined(_WIN64)
+	assert(m_fd != INVALID_SOCKET);
+#else
+	assert(m_fd != -1);
+#endif
+
+	PROFILE_ZONE(ZONE::SEND);
+
+	unsigned int length = 0U;
+	for (unsigned int i = 0U; i < count; i++)
+		length += buffers[i].m_length;
+
+#if defined(_WIN32) || defined(_WIN64)
+	WSABUF wsaBuffers[TCP_MAX_BUFFERS];
+	for (unsigned int i = 0U; i < count; i++) {
+		wsaBuffers[i].buf = (char*)buffers[i].m_data;
+		wsaBuffers[i].len = buffers[i].m_length;
+	}
+
+	DWORD sent = 0UL;
+	int ret = ::WSASend(m_fd, wsaBuffers, DWORD(count), &sent, 0UL, nullptr, nullptr);
+	if (ret != 0 || sent != DWORD(length)) {
+		LogError("Error returned from WSASend, err=%d", ::GetLastError());
+		return false;
+	}
+#else
+	struct iovec iov[TCP_MAX_BUFFERS];
+	for (unsigned int i = 0U; i < count; i++) {
+		iov[i].iov_base = (void*)buffers[i].m_data;
+		iov[i].iov_len  = buffers[i].m_length;
+	}
+
+	struct msghdr msg;
+	::memset(&msg, 0x00U, sizeof(msg));
+	msg.msg_iov    = iov;
+	msg.msg_iovlen = count;
+
+	ssize_t ret = ::sendmsg(m_fd, &msg, 0);
+	if (ret != ssize_t(length)) {
+		LogError("Error returned from sendmsg, err=%d", errno);
+		return false;
+	}
+#endif
+
+	return true;
+}
+
 bool CTCPSocket::writeLine(const std::string& line)
 {
 	std::string lineCopy(line);
@@ -274,6 +330,60 @@ bool CTCPSocket::writeLine(const std::string& line)
 	return result;
 }
 
+#if defined(_WIN32) || defined(_WIN64)
+
+bool CTCPSocket::getInfo(TCPInfo&) const
+{
+	return false;
+}
+
+unsigned int CTCPSocket::getSendQueue() const
+{
+	return 0U;
+}
+
+#else
+
+bool CTCPSocket::getInfo(TCPInfo& info) const
+{
+	if (m_fd == -1)
+		return false;
+
+	struct tcp_info tcpInfo;
+	socklen_t length = sizeof(tcpInfo);
+	if (::getsockopt(m_fd, IPPROTO_TCP, TCP_INFO, &tcpInfo, &length) < 0)
+		return false;
+
+	info.m_rtt         = tcpInfo.tcpi_rtt;
+	info.m_rttVar      = tcpInfo.tcpi_rttvar;
+	info.m_retransmits = tcpInfo.tcpi_total_retrans;
+	info.m_cwnd        = tcpInfo.tcpi_snd_cwnd;
+	info.m_unacked     = tcpInfo.tcpi_unacked;
+
+	info.m_sendQueue = getSendQueue();
+
+	int unsent = 0;
+	if (::ioctl(m_fd, SIOCOUTQNSD, &unsent) < 0)
+		unsent = 0;
+	info.m_unsent = (unsigned int)unsent;
+
+	return true;
+}
+
+unsigned int CTCPSocket::getSendQueue() const
+{
+	if (m_fd == -1)
+		return 0U;
+
+	int queued = 0;
+	if (::ioctl(m_fd, SIOCOUTQ, &queued) < 0)
+		return 0U;
+
+	return (unsigned int)queued;
+}
+
+#endif
+
 void CTCPSocket::close()
 {
 #if defined(_WIN32) || defined(_WIN64)
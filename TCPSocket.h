@@ -28,6 +28,7 @@
 #include <netinet/in.h>
 #include <netinet/tcp.h>
 #include <arpa/inet.h>
+#include <sys/uio.h>
 #include <errno.h>
 #else
 #include <ws2tcpip.h>
@@ -35,6 +36,25 @@
 
 #include <string>
 
+// The most pieces that can be gathered into one write
+const unsigned int TCP_MAX_BUFFERS = 64U;
+
+struct TCPBuffer {
+	const unsigned char* m_data;
+	unsigned int         m_length;
+};
+
+// What the kernel knows about the health of the connection
+struct TCPInfo {
+	unsigned int m_rtt;			// Smoothed round trip time in microseconds
+	unsigned int m_rttVar;			// Its variation in microseconds
+	unsigned int m_retransmits;		// Segments retransmitted since connecting
+	unsigned int m_cwnd;			// Congestion window in segments
+	unsigned int m_unacked;			// Segments sent but not acknowledged
+	unsigned int m_sendQueue;		// Bytes written but not acknowledged
+	unsigned int m_unsent;			// Bytes written but not yet sent
+};
+
 class CTCPSocket {
 public:
 	CTCPSocket(const std::string& address, unsigned int port);
@@ -45,8 +65,16 @@ public:
 	int  read(unsigned char* buffer, unsigned int length, unsigned int secs, unsigned int msecs = 0U);
 	int  readLine(std::string& line, unsigned int secs);
 	bool write(const unsigned char* buffer, unsigned int length);
+	bool write(const TCPBuffer* buffers, unsigned int count);
 	bool writeLine(const std::string& line);
 
+	// Only available on Linux, false elsewhere or when not connected
+	bool getInfo(TCPInfo& info) const;
+
+	// The bytes written but not yet acknowledged by the other end, or
+	// zero where it can't be found
+	unsigned int getSendQueue() const;
+
 	void close();
 
 private:
@@ -0,0 +1,99 @@
+/*
+ *   Copyright (C) 2026 by Jonathan Naylor G4KLX
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program; if not, write to the Free Software
+ *   Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+#if !defined(ThreadSlots_H)
+#define	ThreadSlots_H
+
+#include "Mutex.h"
+
+#include <atomic>
+#include <cassert>
+
+// A set of values for each thread, so that the hot paths can update their own
+// without contention and a reader adds them up. Threads beyond the first N - 1
+// share the last set, so they need atomic updates. There should only be one
+// of each type, since the slot of each thread is kept per type.
+template<class T, unsigned int N> class CThreadSlots {
+public:
+	CThreadSlots() :
+	m_count(0U),
+	m_mutex()
+	{
+		assert(N > 1U);
+	}
+
+	// The values for the calling thread, claimed on the first call
+	T& get()
+	{
+		if (m_slot == nullptr)
+			claim();
+
+		return *m_slot;
+	}
+
+	// Whether the calling thread shares its values, only valid after get()
+	bool isShared() const
+	{
+		return m_shared;
+	}
+
+	// The number of sets of values in use, for a reader
+	unsigned int getCount() const
+	{
+		return m_count.load(std::memory_order_acquire);
+	}
+
+	T& operator[](unsigned int n)
+	{
+		assert(n < N);
+
+		return m_slots[n];
+	}
+
+private:
+	T                         m_slots[N];
+	std::atomic<unsigned int> m_count;
+	CMutex                    m_mutex;
+
+	static thread_local T*    m_slot;
+	static thread_local bool  m_shared;
+
+	void claim()
+	{
+		m_mutex.lock();
+
+		unsigned int count = m_count.load(std::memory_order_relaxed);
+		if (count < N) {
+			m_slot = &m_slots[count];
+			m_count.store(count + 1U, std::memory_order_release);
+		}
+
+		// The last set is shared
+		if (count >= (N - 1U)) {
+			m_slot   = &m_slots[N - 1U];
+			m_shared = true;
+		}
+
+		m_mutex.unlock();
+	}
+};
+
+template<class T, unsigned int N> thread_local T* CThreadSlots<T, N>::m_slot = nullptr;
+template<class T, unsigned int N> thread_local bool CThreadSlots<T, N>::m_shared = false;
+
+#endif
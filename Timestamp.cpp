@@ -0,0 +1,88 @@
+/*
+ *   Copyright (C) 2026 by Jonathan Naylor G4KLX
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program; if not, write to the Free Software
+ *   Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+#include "Timestamp.h"
+
+#if defined(_WIN32) || defined(_WIN64)
+#include <Windows.h>
+#endif
+
+#include <cstdio>
+#include <cstring>
+#include <cassert>
+#include <ctime>
+
+const unsigned int PREFIX_LENGTH = 19U;
+
+static thread_local long long m_second = -1LL;
+static thread_local char      m_prefix[PREFIX_LENGTH];
+
+unsigned long long CTimestamp::getTime()
+{
+#if defined(_WIN32) || defined(_WIN64)
+	FILETIME ft;
+	::GetSystemTimeAsFileTime(&ft);
+
+	ULARGE_INTEGER t;
+	t.LowPart  = ft.dwLowDateTime;
+	t.HighPart = ft.dwHighDateTime;
+
+	// From 100ns units since 1601
+	return (t.QuadPart - 116444736000000000ULL) / 10ULL;
+#else
+	struct timespec now;
+	::clock_gettime(CLOCK_REALTIME, &now);
+
+	return now.tv_sec * 1000000ULL + now.tv_nsec / 1000ULL;
+#endif
+}
+
+unsigned int CTimestamp::format(unsigned long long time, char separator, char* buffer)
+{
+	assert(buffer != nullptr);
+
+	long long second = (long long)(time / 1000000ULL);
+
+	if (second != m_second) {
+		time_t secs = time_t(second);
+
+		struct tm tm;
+#if defined(_WIN32) || defined(_WIN64)
+		::gmtime_s(&tm, &secs);
+#else
+		::gmtime_r(&secs, &tm);
+#endif
+
+		char temp[80U];
+		::sprintf(temp, "%04d-%02d-%02d %02d:%02d:%02d", tm.tm_year + 1900, tm.tm_mon + 1, tm.tm_mday, tm.tm_hour, tm.tm_min, tm.tm_sec);
+		::memcpy(m_prefix, temp, PREFIX_LENGTH);
+		m_second = second;
+	}
+
+	::memcpy(buffer, m_prefix, PREFIX_LENGTH);
+	buffer[10U] = separator;
+
+	unsigned int ms = (unsigned int)((time / 1000ULL) % 1000ULL);
+	buffer[19U] = '.';
+	buffer[20U] = char('0' + ms / 100U);
+	buffer[21U] = char('0' + (ms / 10U) % 10U);
+	buffer[22U] = char('0' + ms % 10U);
+	buffer[23U] = '\0';
+
+	return TIMESTAMP_LENGTH;
+}
@@ -0,0 +1,37 @@
+/*
+ *   Copyright (C) 2026 by Jonathan Naylor G4KLX
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program; if not, write to the Free Software
+ *   Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+#if !defined(Timestamp_H)
+#define	Timestamp_H
+
+// The wall clock, and its formatting for the log and JSON messages. The date
+// and time are only formatted once a second by each thread, after that just
+// the milliseconds are changed.
+class CTimestamp {
+public:
+	// The time since the epoch in microseconds
+	static unsigned long long getTime();
+
+	// Writes "YYYY-MM-DD HH:MM:SS.mmm", with separator between the date and
+	// time, and returns its length. The buffer must hold TIMESTAMP_LENGTH + 1.
+	static unsigned int format(unsigned long long time, char separator, char* buffer);
+};
+
+const unsigned int TIMESTAMP_LENGTH = 23U;
+
+#endif
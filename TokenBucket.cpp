@@ -0,0 +1,121 @@
+/*
+ *   Copyright (C) 2026 by Jonathan Naylor G4KLX
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program; if not, write to the Free Software
+ *   Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+#include "TokenBucket.h"
+
+#include <cassert>
+
+const unsigned long long SCALE = 1000000ULL;
+
+CTokenBucket::CTokenBucket(unsigned int rate, unsigned int burst) :
+m_rate(0ULL),
+m_burst(0ULL),
+m_tokens(0ULL),
+m_last(0ULL)
+{
+	setRate(rate, burst);
+}
+
+CTokenBucket::~CTokenBucket()
+{
+}
+
+void CTokenBucket::setRate(unsigned int rate, unsigned int burst)
+{
+	// Always allow at least one token through
+	if (burst == 0U)
+		burst = 1U;
+
+	m_rate   = rate;
+	m_burst  = burst * SCALE;
+	m_tokens = m_burst;
+	m_last   = 0ULL;
+}
+
+bool CTokenBucket::isLimited() const
+{
+	return m_rate > 0ULL;
+}
+
+unsigned long long CTokenBucket::getDelay(unsigned int cost, unsigned long long now)
+{
+	if (m_rate == 0ULL)
+		return 0ULL;
+
+	refill(now);
+
+	// Anything larger than the burst waits for a full bucket
+	unsigned long long needed = cost * SCALE;
+	if (needed > m_burst)
+		needed = m_burst;
+
+	if (m_tokens >= needed)
+		return 0ULL;
+
+	// The tokens are added at m_rate millionths per microsecond
+	return (needed - m_tokens + m_rate - 1ULL) / m_rate;
+}
+
+unsigned int CTokenBucket::getAvailable(unsigned long long now)
+{
+	assert(m_rate > 0ULL);
+
+	refill(now);
+
+	return (unsigned int)(m_tokens / SCALE);
+}
+
+void CTokenBucket::take(unsigned int cost)
+{
+	if (m_rate == 0ULL)
+		return;
+
+	unsigned long long taken = cost * SCALE;
+	if (taken > m_burst)
+		taken = m_burst;
+
+	m_tokens = (m_tokens > taken) ? (m_tokens - taken) : 0ULL;
+}
+
+void CTokenBucket::refund(unsigned int cost)
+{
+	if (m_rate == 0ULL)
+		return;
+
+	unsigned long long given = cost * SCALE;
+	if (given > m_burst)
+		given = m_burst;
+
+	m_tokens += given;
+	if (m_tokens > m_burst)
+		m_tokens = m_burst;
+}
+
+void CTokenBucket::refill(unsigned long long now)
+{
+	if (m_last == 0ULL || now < m_last) {
+		m_last = now;
+		return;
+	}
+
+	m_tokens += (now - m_last) * m_rate;
+	if (m_tokens > m_burst)
+		m_tokens = m_burst;
+
+	m_last = now;
+}
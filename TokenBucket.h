@@ -0,0 +1,54 @@
+/*
+ *   Copyright (C) 2026 by Jonathan Naylor G4KLX
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program; if not, write to the Free Software
+ *   Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+#if !defined(TokenBucket_H)
+#define	TokenBucket_H
+
+// Limits a rate, such as frames or bytes a second, while allowing a short
+// burst. Times are in microseconds, and the tokens are held in millionths so
+// that slow rates don't lose accuracy. A rate of zero is unlimited.
+class CTokenBucket {
+public:
+	CTokenBucket(unsigned int rate = 0U, unsigned int burst = 0U);
+	~CTokenBucket();
+
+	void setRate(unsigned int rate, unsigned int burst);
+
+	bool isLimited() const;
+
+	// How long until cost tokens are available, zero if they are now
+	unsigned long long getDelay(unsigned int cost, unsigned long long now);
+
+	// How many tokens are available now
+	unsigned int getAvailable(unsigned long long now);
+
+	void take(unsigned int cost);
+
+	// Gives back what take() took for something that didn't happen after all
+	void refund(unsigned int cost);
+
+private:
+	unsigned long long m_rate;
+	unsigned long long m_burst;
+	unsigned long long m_tokens;
+	unsigned long long m_last;
+
+	void refill(unsigned long long now);
+};
+
+#endif
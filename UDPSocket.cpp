@@ -0,0 +1,187 @@
+/*
+ *   Copyright (C) 2026 by Jonathan Naylor G4KLX
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program; if not, write to the Free Software
+ *   Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+#include "UDPSocket.h"
+#include "Profile.h"
+#include "Log.h"
+
+#include <cstdio>
+#include <cassert>
+#include <cstring>
+
+#if defined(_WIN32) || defined(_WIN64)
+typedef int ssize_t;
+#else
+#include <cerrno>
+#endif
+
+CUDPSocket::CUDPSocket() :
+#if defined(_WIN32) || defined(_WIN64)
+m_fd(INVALID_SOCKET)
+#else
+m_fd(-1)
+#endif
+{
+#if defined(_WIN32) || defined(_WIN64)
+	WSAData data;
+	int wsaRet = ::WSAStartup(MAKEWORD(2, 2), &data);
+	if (wsaRet != 0)
+		LogError("Error from WSAStartup");
+#endif
+}
+
+CUDPSocket::~CUDPSocket()
+{
+#if defined(_WIN32) || defined(_WIN64)
+	::WSACleanup();
+#endif
+}
+
+int CUDPSocket::lookup(const std::string& hostname, unsigned short port, sockaddr_storage& addr, unsigned int& addressLength)
+{
+	char portstr[10U];
+	::sprintf(portstr, "%u", port);
+
+	struct addrinfo hints;
+	::memset(&hints, 0, sizeof(hints));
+	hints.ai_socktype = SOCK_DGRAM;
+	hints.ai_flags    = AI_NUMERICSERV;
+
+	struct addrinfo* res;
+	int err = ::getaddrinfo(hostname.c_str(), portstr, &hints, &res);
+	if (err != 0) {
+		LogError("Cannot find address for host %s", hostname.c_str());
+		return err;
+	}
+
+	::memcpy(&addr, res->ai_addr, addressLength = (unsigned int)res->ai_addrlen);
+
+	::freeaddrinfo(res);
+
+	return 0;
+}
+
+bool CUDPSocket::open(const sockaddr_storage& address)
+{
+#if defined(_WIN32) || defined(_WIN64)
+	if (m_fd != INVALID_SOCKET)
+		return true;
+#else
+	if (m_fd != -1)
+		return true;
+#endif
+
+	m_fd = ::socket(address.ss_family, SOCK_DGRAM, 0);
+	if (m_fd < 0) {
+#if defined(_WIN32) || defined(_WIN64)
+		LogError("Cannot create the UDP socket, err=%d", ::GetLastError());
+#else
+		LogError("Cannot create the UDP socket, err=%d", errno);
+#endif
+		return false;
+	}
+
+	return true;
+}
+
+bool CUDPSocket::write(const unsigned char* buffer, unsigned int length, const sockaddr_storage& address, unsigned int addressLength)
+{
+	assert(buffer != nullptr);
+	assert(length > 0U);
+
+	PROFILE_ZONE(ZONE::SEND);
+
+	ssize_t ret = ::sendto(m_fd, (char *)buffer, length, 0, (sockaddr *)&address, addressLength);
+	if (ret != ssize_t(length)) {
+#if defined(_WIN32) || defined(_WIN64)
+		LogError("Error returned from sendto, err=%d", ::GetLastError());
+#else
+		LogError("Error returned from sendto, err=%d", errno);
+#endif
+		return false;
+	}
+
+	return true;
+}
+
+int CUDPSocket::write(const UDPDatagram* datagrams, unsigned int count, const sockaddr_storage& address, unsigned int addressLength)
+{
+	assert(datagrams != nullptr);
+
+	PROFILE_ZONE(ZONE::SEND);
+
+	if (count > UDP_BATCH)
+		count = UDP_BATCH;
+
+#if defined(_WIN32) || defined(_WIN64)
+	// No sendmmsg() so the pieces of each datagram are gathered with WSASendTo()
+	for (unsigned int i = 0U; i < count; i++) {
+		WSABUF buffers[3U];
+		for (unsigned int j = 0U; j < datagrams[i].m_count; j++) {
+			buffers[j].buf = (CHAR*)datagrams[i].m_data[j];
+			buffers[j].len = datagrams[i].m_length[j];
+		}
+
+		DWORD sent = 0U;
+		if (::WSASendTo(m_fd, buffers, datagrams[i].m_count, &sent, 0U, (sockaddr*)&address, addressLength, nullptr, nullptr) == SOCKET_ERROR) {
+			LogError("Error returned from WSASendTo, err=%d", ::WSAGetLastError());
+			return (i > 0U) ? int(i) : -1;
+		}
+	}
+
+	return int(count);
+#else
+	struct mmsghdr msgs[UDP_BATCH];
+	struct iovec   iovecs[UDP_BATCH][3U];
+
+	::memset(msgs, 0x00, sizeof(msgs));
+
+	for (unsigned int i = 0U; i < count; i++) {
+		for (unsigned int j = 0U; j < datagrams[i].m_count; j++) {
+			iovecs[i][j].iov_base = (void*)datagrams[i].m_data[j];
+			iovecs[i][j].iov_len  = datagrams[i].m_length[j];
+		}
+
+		msgs[i].msg_hdr.msg_name    = (void*)&address;
+		msgs[i].msg_hdr.msg_namelen = addressLength;
+		msgs[i].msg_hdr.msg_iov     = iovecs[i];
+		msgs[i].msg_hdr.msg_iovlen  = datagrams[i].m_count;
+	}
+
+	int ret = ::sendmmsg(m_fd, msgs, count, 0);
+	if (ret < 0)
+		LogError("Error returned from sendmmsg, err=%d", errno);
+
+	return ret;
+#endif
+}
+
+void CUDPSocket::close()
+{
+#if defined(_WIN32) || defined(_WIN64)
+	if (m_fd != INVALID_SOCKET) {
+		::closesocket(m_fd);
+		m_fd = INVALID_SOCKET;
+	}
+#else
+	if (m_fd != -1) {
+		::close(m_fd);
+		m_fd = -1;
+	}
+#endif
+}
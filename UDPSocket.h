@@ -0,0 +1,72 @@
+/*
+ *   Copyright (C) 2026 by Jonathan Naylor G4KLX
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program; if not, write to the Free Software
+ *   Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+#ifndef UDPSocket_H
+#define UDPSocket_H
+
+#if !defined(_WIN32) && !defined(_WIN64)
+#include <netdb.h>
+#include <sys/time.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <sys/uio.h>
+#include <errno.h>
+#else
+#include <ws2tcpip.h>
+#endif
+
+#include <string>
+
+// The most datagrams sent by one batch write
+const unsigned int UDP_BATCH = 32U;
+
+// A datagram made from up to three pieces, which are sent together
+struct UDPDatagram {
+	const unsigned char* m_data[3U];
+	unsigned int         m_length[3U];
+	unsigned int         m_count;
+};
+
+class CUDPSocket {
+public:
+	CUDPSocket();
+	~CUDPSocket();
+
+	bool open(const sockaddr_storage& address);
+
+	bool write(const unsigned char* buffer, unsigned int length, const sockaddr_storage& address, unsigned int addressLength);
+
+	// Sends a batch of datagrams with as few system calls as possible, returns the number sent or -1
+	int  write(const UDPDatagram* datagrams, unsigned int count, const sockaddr_storage& address, unsigned int addressLength);
+
+	void close();
+
+	static int lookup(const std::string& hostName, unsigned short port, sockaddr_storage& address, unsigned int& addressLength);
+
+private:
+#if defined(_WIN32) || defined(_WIN64)
+	SOCKET         m_fd;
+#else
+	int            m_fd;
+#endif
+};
+
+#endif
@@ -12,9 +12,11 @@
  */
 
 #include "Utils.h"
+#include "Timestamp.h"
 #include "Log.h"
 
 #include <cstdio>
+#include <cstring>
 #include <cassert>
 
 #if defined(_WIN32) || defined(_WIN64)
@@ -26,6 +28,11 @@
 
 const std::string LINEENDING = " \n\r";
 
+const char HEX_DIGITS[] = "0123456789ABCDEF";
+
+// A new line, the offset, 16 bytes in hex, the gap and 16 characters between stars
+const unsigned int DUMP_ROW_LENGTH = 1U + 7U + 48U + 4U + 16U + 1U;
+
 void CUtils::dump(const std::string& title, const unsigned char* data, unsigned int length)
 {
 	assert(data != nullptr);
@@ -37,46 +44,67 @@ void CUtils::dump(int level, const std::string& title, const unsigned char* data
 {
 	assert(data != nullptr);
 
-	::Log(level, "%s", title.c_str());
+	// The whole dump is built in one buffer and logged as a single record
+	char buffer[LOG_BLOCK_LENGTH];
 
-	unsigned int offset = 0U;
+	unsigned int titleLength = (unsigned int)title.size();
+	if (titleLength > (LOG_BLOCK_LENGTH - DUMP_ROW_LENGTH))
+		titleLength = LOG_BLOCK_LENGTH - DUMP_ROW_LENGTH;
 
-	while (length > 0U) {
-		std::string output;
+	::memcpy(buffer, title.c_str(), titleLength);
+	unsigned int n = titleLength;
 
-		unsigned int bytes = (length > 16U) ? 16U : length;
+	unsigned int offset = 0U;
 
-		for (unsigned i = 0U; i < bytes; i++) {
-			char temp[10U];
-			::sprintf(temp, "%02X ", data[offset + i]);
-			output += temp;
+	while (offset < length) {
+		// Start a new record when this one is full
+		if ((n + DUMP_ROW_LENGTH) > LOG_BLOCK_LENGTH) {
+			::LogText(level, buffer, n);
+			n = 0U;
+		} else {
+			buffer[n++] = '\n';
 		}
 
-		for (unsigned int i = bytes; i < 16U; i++)
-			output += "   ";
+		unsigned int bytes = length - offset;
+		if (bytes > 16U)
+			bytes = 16U;
 
-		output += "   *";
+		buffer[n++] = HEX_DIGITS[(offset >> 12) & 0x0FU];
+		buffer[n++] = HEX_DIGITS[(offset >> 8) & 0x0FU];
+		buffer[n++] = HEX_DIGITS[(offset >> 4) & 0x0FU];
+		buffer[n++] = HEX_DIGITS[offset & 0x0FU];
+		buffer[n++] = ':';
+		buffer[n++] = ' ';
+		buffer[n++] = ' ';
 
-		for (unsigned i = 0U; i < bytes; i++) {
-			unsigned char c = data[offset + i];
+		const unsigned char* p = data + offset;
 
-			if (::isprint(c))
-				output += c;
-			else
-				output += '.';
+		for (unsigned int i = 0U; i < bytes; i++) {
+			buffer[n++] = HEX_DIGITS[p[i] >> 4];
+			buffer[n++] = HEX_DIGITS[p[i] & 0x0FU];
+			buffer[n++] = ' ';
 		}
 
-		output += '*';
+		for (unsigned int i = bytes; i < 16U; i++) {
+			buffer[n++] = ' ';
+			buffer[n++] = ' ';
+			buffer[n++] = ' ';
+		}
 
-		::Log(level, "%04X:  %s", offset, output.c_str());
+		buffer[n++] = ' ';
+		buffer[n++] = ' ';
+		buffer[n++] = ' ';
+		buffer[n++] = '*';
 
-		offset += 16U;
+		for (unsigned int i = 0U; i < bytes; i++)
+			buffer[n++] = (p[i] >= 0x20U && p[i] < 0x7FU) ? char(p[i]) : '.';
 
-		if (length >= 16U)
-			length -= 16U;
-		else
-			length = 0U;
+		buffer[n++] = '*';
+
+		offset += 16U;
 	}
+
+	::LogText(level, buffer, n);
 }
 
 std::string CUtils::rtrim(const std::string& s)
@@ -87,22 +115,11 @@ std::string CUtils::rtrim(const std::string& s)
 
 std::string CUtils::createTimestamp()
 {
-	char buffer[100U];
-
-#if defined(_WIN32) || defined(_WIN64)
-	SYSTEMTIME st;
-	::GetSystemTime(&st);
-
-	::sprintf(buffer, "%04u-%02u-%02uT%02u:%02u:%02u.%03uZ", st.wYear, st.wMonth, st.wDay, st.wHour, st.wMinute, st.wSecond, st.wMilliseconds);
-#else
-	struct timeval now;
-	::gettimeofday(&now, nullptr);
-
-	struct tm* tm = ::gmtime(&now.tv_sec);
+	char buffer[TIMESTAMP_LENGTH + 2U];
 
-	::sprintf(buffer, "%04d-%02d-%02dT%02d:%02d:%02d.%03lldZ", tm->tm_year + 1900, tm->tm_mon + 1, tm->tm_mday, tm->tm_hour, tm->tm_min, tm->tm_sec, now.tv_usec / 1000LL);
-#endif
+	unsigned int length = CTimestamp::format(CTimestamp::getTime(), 'T', buffer);
+	buffer[length++] = 'Z';
+	buffer[length]   = '\0';
 
 	return buffer;
 }
-
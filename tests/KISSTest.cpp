@@ -0,0 +1,239 @@
+/*
+ *   Copyright (C) 2026 by Jonathan Naylor G4KLX
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program; if not, write to the Free Software
+ *   Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+// Plays the part of a software TNC. The KISS thread connects to it, and it
+// sends known AX.25 frames, escaped and split across writes as a real TNC
+// might, then checks the TNC2 text that comes out of the other side.
+
+#include "APRSKISSThread.h"
+#include "Thread.h"
+
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <unistd.h>
+#include <poll.h>
+
+#include <atomic>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+const unsigned char KISS_FEND  = 0xC0U;
+const unsigned char KISS_FESC  = 0xDBU;
+const unsigned char KISS_TFEND = 0xDCU;
+const unsigned char KISS_TFESC = 0xDDU;
+
+const unsigned int TEST_TIMEOUT = 5000U;
+
+// APRS via WIDE1-1*,WIDE2-1 from N0CALL-7, the H bit marks WIDE1-1 as used
+static const unsigned char FRAME1[] = {
+	0x82U, 0xA0U, 0xA4U, 0xA6U, 0x40U, 0x40U, 0x60U,
+	0x9CU, 0x60U, 0x86U, 0x82U, 0x98U, 0x98U, 0x6EU,
+	0xAEU, 0x92U, 0x88U, 0x8AU, 0x62U, 0x40U, 0xE2U,
+	0xAEU, 0x92U, 0x88U, 0x8AU, 0x64U, 0x40U, 0x63U,
+	0x03U, 0xF0U,
+	'!', '4', '9', '0', '3', '.', '5', '0', 'N', '/', '0', '7', '2', '0', '1', '.', '7', '5', 'W', '-', 'T', 'e', 's', 't'
+};
+
+// APDG03 from G4KLX with no digipeaters
+static const unsigned char FRAME2[] = {
+	0x82U, 0xA0U, 0x88U, 0x8EU, 0x60U, 0x66U, 0x60U,
+	0x8EU, 0x68U, 0x96U, 0x98U, 0xB0U, 0x40U, 0x61U,
+	0x03U, 0xF0U,
+	'>', 'H', 'e', 'l', 'l', 'o'
+};
+
+// As above but an I frame rather than a UI frame
+static const unsigned char FRAME3[] = {
+	0x82U, 0xA0U, 0x88U, 0x8EU, 0x60U, 0x66U, 0x60U,
+	0x8EU, 0x68U, 0x96U, 0x98U, 0xB0U, 0x40U, 0x61U,
+	0x00U, 0xF0U,
+	'>', 'H', 'e', 'l', 'l', 'o'
+};
+
+// As above but in lower case, which can't be in a callsign
+static const unsigned char FRAME4[] = {
+	0x82U, 0xA0U, 0x88U, 0x8EU, 0x60U, 0x66U, 0x60U,
+	0x8EU, 0x68U, 0xD6U, 0xD8U, 0xF0U, 0x40U, 0x61U,
+	0x03U, 0xF0U,
+	'>', 'H', 'e', 'l', 'l', 'o'
+};
+
+// The addresses are never ended
+static const unsigned char FRAME5[] = {
+	0x82U, 0xA0U, 0x88U, 0x8EU, 0x60U, 0x66U, 0x60U,
+	0x8EU, 0x68U, 0x96U, 0x98U, 0xB0U, 0x40U, 0x60U
+};
+
+// APDG03 from G4KLX-15, with FEND and FESC in the information that must be escaped
+static const unsigned char FRAME6[] = {
+	0x82U, 0xA0U, 0x88U, 0x8EU, 0x60U, 0x66U, 0x60U,
+	0x8EU, 0x68U, 0x96U, 0x98U, 0xB0U, 0x40U, 0x7FU,
+	0x03U, 0xF0U,
+	'>', 0xC0U, 'x', 0xDBU
+};
+
+static const struct {
+	const unsigned char* m_frame;
+	unsigned int         m_length;
+	const char*          m_text;		// nullptr if the frame is invalid
+} FRAMES[] = {
+	{FRAME1, sizeof(FRAME1), "N0CALL-7>APRS,WIDE1-1*,WIDE2-1:!4903.50N/07201.75W-Test"},
+	{FRAME3, sizeof(FRAME3), nullptr},
+	{FRAME4, sizeof(FRAME4), nullptr},
+	{FRAME5, sizeof(FRAME5), nullptr},
+	{FRAME6, sizeof(FRAME6), "G4KLX-15>APDG03:>\xC0x\xDB"},
+	{FRAME2, sizeof(FRAME2), "G4KLX>APDG03:>Hello"}
+};
+
+const unsigned int FRAME_COUNT = sizeof(FRAMES) / sizeof(FRAMES[0U]);
+
+static std::vector<std::string> m_received;
+static std::atomic<unsigned int> m_count(0U);
+
+static void onFrame(const unsigned char* data, unsigned int length)
+{
+	m_received.push_back(std::string((const char*)data, length));
+	m_count.fetch_add(1U, std::memory_order_release);
+}
+
+static void encode(std::string& stream, unsigned char command, const unsigned char* data, unsigned int length)
+{
+	stream.push_back((char)KISS_FEND);
+	stream.push_back((char)command);
+
+	for (unsigned int i = 0U; i < length; i++) {
+		if (data[i] == KISS_FEND) {
+			stream.push_back((char)KISS_FESC);
+			stream.push_back((char)KISS_TFEND);
+		} else if (data[i] == KISS_FESC) {
+			stream.push_back((char)KISS_FESC);
+			stream.push_back((char)KISS_TFESC);
+		} else {
+			stream.push_back((char)data[i]);
+		}
+	}
+
+	stream.push_back((char)KISS_FEND);
+}
+
+int main()
+{
+	int listenFd = ::socket(AF_INET, SOCK_STREAM, 0);
+	if (listenFd < 0) {
+		::fprintf(stderr, "KISS test: cannot create the TNC socket\n");
+		return 1;
+	}
+
+	struct sockaddr_in addr;
+	::memset(&addr, 0x00, sizeof(addr));
+	addr.sin_family      = AF_INET;
+	addr.sin_port        = 0U;
+	addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+	socklen_t addrLen = sizeof(addr);
+	if (::bind(listenFd, (struct sockaddr*)&addr, sizeof(addr)) < 0 || ::listen(listenFd, 1) < 0 || ::getsockname(listenFd, (struct sockaddr*)&addr, &addrLen) < 0) {
+		::fprintf(stderr, "KISS test: cannot listen for the KISS thread\n");
+		::close(listenFd);
+		return 1;
+	}
+
+	CAPRSKISSThread kiss("127.0.0.1", ntohs(addr.sin_port));
+	kiss.setCallback(onFrame);
+	kiss.start();
+
+	struct pollfd pfd;
+	pfd.fd     = listenFd;
+	pfd.events = POLLIN;
+	if (::poll(&pfd, 1, TEST_TIMEOUT) != 1) {
+		::fprintf(stderr, "KISS test: the KISS thread did not connect\n");
+		kiss.stop();
+		::close(listenFd);
+		return 1;
+	}
+
+	int fd = ::accept(listenFd, nullptr, nullptr);
+	::close(listenFd);
+	if (fd < 0) {
+		::fprintf(stderr, "KISS test: cannot accept the KISS thread\n");
+		kiss.stop();
+		return 1;
+	}
+
+	// A TXDELAY command first, which isn't a data frame and must be ignored
+	std::string stream;
+	const unsigned char txDelay = 50U;
+	encode(stream, 0x01U, &txDelay, 1U);
+
+	unsigned int expected = 0U;
+	for (unsigned int i = 0U; i < FRAME_COUNT; i++) {
+		encode(stream, 0x00U, FRAMES[i].m_frame, FRAMES[i].m_length);
+		if (FRAMES[i].m_text != nullptr)
+			expected++;
+	}
+
+	// Split the stream so that frames arrive in pieces
+	std::string::size_type half = stream.size() / 2U;
+	::send(fd, stream.data(), half, 0);
+	CThread::sleep(50U);
+	::send(fd, stream.data() + half, stream.size() - half, 0);
+
+	// The last frame is valid, so once it is seen every other frame has been handled
+	for (unsigned int i = 0U; i < TEST_TIMEOUT && m_count.load(std::memory_order_acquire) < expected; i += 10U)
+		CThread::sleep(10U);
+
+	kiss.stop();
+	::close(fd);
+
+	unsigned int failures = 0U;
+
+	if (m_received.size() != expected) {
+		::fprintf(stderr, "KISS test: %u frames gated, expected %u\n", (unsigned int)m_received.size(), expected);
+		failures++;
+	}
+
+	unsigned int n = 0U;
+	for (unsigned int i = 0U; i < FRAME_COUNT && n < m_received.size(); i++) {
+		if (FRAMES[i].m_text == nullptr)
+			continue;
+
+		std::string text(FRAMES[i].m_text);
+		if (m_received[n] != text) {
+			::fprintf(stderr, "KISS test: frame %u decoded as \"%s\", expected \"%s\"\n", i + 1U, m_received[n].c_str(), text.c_str());
+			failures++;
+		}
+
+		n++;
+	}
+
+	if (kiss.getFrames() != expected || kiss.getInvalid() != (FRAME_COUNT - expected)) {
+		::fprintf(stderr, "KISS test: %u frames and %u invalid counted, expected %u and %u\n", kiss.getFrames(), kiss.getInvalid(), expected, FRAME_COUNT - expected);
+		failures++;
+	}
+
+	if (failures > 0U) {
+		::fprintf(stderr, "KISS test: %u failures\n", failures);
+		return 1;
+	}
+
+	::fprintf(stdout, "KISS test: %u frames passed\n", FRAME_COUNT);
+
+	return 0;
+}